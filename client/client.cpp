@@ -198,7 +198,7 @@ void Client::MainLoop() {
         auto socket_done =
             this->socket.state != Socket_State::CONNECTED ||
             !this->finish_outbound_packets ||
-            this->socket.send.queue.empty();
+            this->socket.send.IsEmpty();
 
         if (this->quit_flag && socket_done) {
             break;
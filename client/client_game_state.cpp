@@ -84,6 +84,33 @@ ClientGameState::ClientGameState() {
             return true;
         };
 
+    this->command_callbacks[GameCommand::Type::DESTROY_ENTITIES] =
+        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
+            auto &destroy_entities = static_cast<DestroyEntitiesCommand &>(command);
+
+            for (auto target : destroy_entities.targets) {
+                if (state.entities.IsValid(Entity{target})) {
+                    state.entities.Destroy(Entity{target});
+                }
+            }
+
+            return true;
+        };
+
+    this->command_callbacks[GameCommand::Type::FIRE_TRACERS] =
+        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
+            auto &fire_tracers = static_cast<FireTracersCommand &>(command);
+
+            for (const auto &tracer : fire_tracers.tracers) {
+                state.tracers.emplace_back(Tracer{tracer.from, tracer.to, state.time});
+            }
+
+            // Once per tick, no matter how many tanks are firing
+            auto &client = GetClient();
+            client.PlaySample(client.assets.sounds.tank_fire);
+            return true;
+        };
+
     this->command_callbacks[GameCommand::Type::SET_HEALTH] =
         [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
             auto &set_health = static_cast<SetHealthCommand &>(command);
@@ -113,14 +140,6 @@ ClientGameState::ClientGameState() {
             }
         };
 
-    this->command_callbacks[GameCommand::Type::SET_POSITION] =
-        [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
-            auto &set_position = static_cast<SetPositionCommand &>(command);
-            auto &position = state.entities.Get<CPosition>(Entity{set_position.target});
-            position.value = set_position.position;
-            return true;
-        };
-
     this->command_callbacks[GameCommand::Type::SWITCH_WEAPON] =
         [](ClientGameState &state, const CommandContext &context, GameCommand &command) {
             auto &switch_weapon = static_cast<SwitchWeaponCommand &>(command);
@@ -138,6 +157,9 @@ bool ClientGameState::Deserialize(Packet &packet) {
         packet.ReadU8(this->background_color.a) &&
         packet.ReadF32(this->size.x) &&
         packet.ReadF32(this->size.y) &&
+        this->settings.Deserialize(packet) &&
+        packet.ReadF32(this->time) &&
+        packet.ReadU32(this->tick) &&
         DeserializeEntities(this->entities, packet);
 }
 
@@ -150,8 +172,31 @@ bool ClientGameState::HandleCommand(const CommandContext &context, GameCommand &
     return it->second(*this, context, command);;
 }
 
-void ClientGameState::DestroyEntity(Entity entity) {
-    // TODO
+void ClientGameState::OnDestroyEntities(const Array<Entity> &destroyed) {
+    // Only reached in the deterministic mode, otherwise the server sends DestroyEntitiesCommand
+    auto tank_destroyed = std::any_of(destroyed.begin(), destroyed.end(),
+        [&](Entity entity) {
+            return this->entities.TryGet<CTank>(entity) != nullptr;
+        });
+
+    if (tank_destroyed) {
+        auto &client = GetClient();
+        client.PlaySample(client.assets.sounds.tank_explode);
+    }
+}
+
+bool ClientGameState::FireProjectile(Entity firing_tank) {
+    if (!this->settings.deterministic) {
+        return false;
+    }
+
+    if (this->Fire(firing_tank, false).empty()) {
+        return false;
+    }
+
+    auto &client = GetClient();
+    client.PlaySample(client.assets.sounds.tank_fire);
+    return true;
 }
 
 void ClientGameState::Clone(ClientGameState &target) const {
@@ -162,20 +207,20 @@ void ClientGameState::Clone(ClientGameState &target) const {
     target.is_pause_menu_open = this->is_pause_menu_open;
 }
 
-void ClientGameState::SimulateProjectileMovement(Vec2 direction, f32 charge, Array<Vec2> &output, size_t num_ticks) const {
-    ClientGameState alternative_reality;
-    this->Clone(alternative_reality);
-
-    auto projectiles = alternative_reality.Fire(this->my_tank.value(), true);
-
-    if (projectiles.size() != 1) {
-        return;
-    }
-
-    auto projectile = projectiles[0];
-    for (size_t i = 0; i < num_ticks; ++i) {
-        alternative_reality.Tick(1.0f);
-        auto position_after_tick = alternative_reality.entities.Get<CPosition>(projectile).value;
-        output.emplace_back(position_after_tick);
-    }
+// Path of a projectile of the current weapon over its lifetime, without the spread
+void ClientGameState::SimulateProjectileMovement(Vec2 direction, f32 charge, Array<Vec2> &output) {
+    auto tank_entity = this->my_tank.value();
+    const auto &weapon = g_weapons[static_cast<size_t>(this->entities.Get<CTank>(tank_entity).weapon_type)];
+
+    // Same launch speed as GameState::Fire
+    auto velocity = direction * (charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * weapon.speed;
+
+    this->trajectory_predictor.Capture(*this);
+    this->trajectory_predictor.Predict(
+        this->GetTankWorldPosition(tank_entity),
+        velocity,
+        weapon.projectile_mass,
+        CProjectile{}.radius,
+        weapon.projectile_ttl,
+        output);
 }
@@ -1,10 +1,20 @@
 #include "common/game_state.hpp"
+#include "common/trajectory_predictor.hpp"
 
 #include "client/graphics/camera.hpp"
 
 union SDL_Event;
 
 struct ClientGameState : public GameState {
+    // A hitscan round as the server traced it, drawn until it faded out
+    struct Tracer {
+        Vec2 from;
+        Vec2 to;
+        f32 time;
+    };
+
+    constexpr static f32 TRACER_LIFETIME = 8.0f;
+
     using CommandCallback = bool(ClientGameState &, const CommandContext &, GameCommand &);
     using CommandCallbackMap = std::unordered_map<GameCommand::Type, CommandCallback *>;
 
@@ -13,12 +23,15 @@ struct ClientGameState : public GameState {
     bool HandleInput(Entity controlled_entity, const SDL_Event &event);
     bool HandleCommand(const CommandContext &context, GameCommand &command) final;
     void Render();
-    void DestroyEntity(Entity entity) final;
+    void OnDestroyEntities(const Array<Entity> &destroyed) final;
+    bool FireProjectile(Entity firing_tank) final;
     void Clone(ClientGameState &target) const;
-    void SimulateProjectileMovement(Vec2 direction, f32 charge, Array<Vec2> &output, size_t num_ticks) const;
+    void SimulateProjectileMovement(Vec2 direction, f32 charge, Array<Vec2> &output);
 
     Camera cam;
     CommandCallbackMap command_callbacks;
+    TrajectoryPredictor trajectory_predictor;
+    Array<Tracer> tracers;
     Optional<Entity> my_tank;
     bool is_pause_menu_open = false;
     bool is_camera_locked = false;
@@ -74,4 +74,10 @@ void RegisterClientCommands() {
             }
         });
 
+    command_manager.RegisterCommand(
+        "tick_stats",
+        [](const Array<String> &args) {
+            // Answered while in game, the server has to consider us an admin
+            GetClient().Send(TickStatsRequest{});
+        });
 }
@@ -61,6 +61,29 @@ static void RenderProjectiles(ClientGameState &state) {
     RenderNormalmap(state, diffuse_texture, normal_map, instances, state.GetSunPosition());
 }
 
+static void RenderTracers(ClientGameState &state) {
+    auto it = std::remove_if(state.tracers.begin(), state.tracers.end(),
+        [&](const ClientGameState::Tracer &tracer) {
+            return state.time - tracer.time > ClientGameState::TRACER_LIFETIME;
+        });
+    state.tracers.erase(it, state.tracers.end());
+
+    if (state.tracers.empty()) {
+        return;
+    }
+
+    // All of them in one draw call, fading out over their lifetime
+    VertexArray va;
+    for (const auto &tracer : state.tracers) {
+        auto alpha = 1.0f - std::max(0.0f, state.time - tracer.time) / ClientGameState::TRACER_LIFETIME;
+        auto color = Color{255, 230, 140, static_cast<u8>(255.0f * alpha)};
+        va.AddPoint(tracer.from, color);
+        va.AddPoint(tracer.to, color);
+    }
+
+    GetGraphicsManager().DrawLines(va, GetClient().assets.textures.white_pixel, state.cam);
+}
+
 static void RenderPlanets(ClientGameState &state) {
     auto &diffuse_texture = GetClient().assets.textures.planet_diffuse;
     auto &normal_map = GetClient().assets.textures.planet_normal;
@@ -265,8 +288,9 @@ static void RenderTanks(ClientGameState &state) {
             CPlanetPosition &planet_position) {
                 Vec2 tank_dest_size{tank_diffuse_texture.dim.x * tank_aspect, CTank::BASE_HEIGHT};
                 Vec2 turret_dest_size{tank_turret_diffuse_texture.dim.x * turret_aspect, CTank::TURRET_HEIGHT};
-                auto dest_position = state.GetTankWorldPosition(entity) - tank_dest_size / 2.0f;
-                auto turret_dest_position = state.GetTankWorldPosition(entity) - Vec2{turret_dest_size.x / 2.0f, 0.0f};
+                auto tank_position = state.GetTankWorldPosition(entity);
+                auto dest_position = tank_position - tank_dest_size / 2.0f;
+                auto turret_dest_position = tank_position - Vec2{turret_dest_size.x / 2.0f, 0.0f};
 
                 tank_instances.Add(dest_position, tank_dest_size, planet_position.value - 90.0f);
                 turret_instances.Add(turret_dest_position, turret_dest_size, Vec2{turret_dest_size.x / 2.0f, 0.0f}, -tank.turret_rotation);
@@ -343,9 +367,22 @@ static void RenderFuel(ClientGameState &state) {
 }
 
 void RenderAimGuide(ClientGameState &state) {
-    return;
+    auto tank_entity = state.my_tank.value();
+    if (!state.entities.IsValid(tank_entity)) {
+        return;
+    }
+
+    auto &tank = state.entities.Get<CTank>(tank_entity);
+    auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation));
+
+    // While charging the guide shows the current charge, otherwise a fully charged shot
+    auto charge = Weapon::MAX_CHARGE;
+    if (auto charging = state.entities.TryGet<CCharging>(tank_entity)) {
+        charge = std::min(state.time - charging->start_time, Weapon::MAX_CHARGE);
+    }
+
     Array<Vec2> path;
-    state.SimulateProjectileMovement(Vec2{1.0f, 1.0f}, 1.0f, path, 25);
+    state.SimulateProjectileMovement(direction, charge, path);
 
     /*Vertex_Array vertex_array;
     vertex_array.create_default_quad();
@@ -362,7 +399,7 @@ void RenderAimGuide(ClientGameState &state) {
     for (const auto &position : path) {
         Mat4 model{1.0};
         model = glm::translate(model, Vec3{position, 0.0f});
-        model = glm::scale(model, Vec3{4.0f, 4.0f, 1.0f});
+        model = glm::scale(model, Vec3{3.0f, 3.0f, 1.0f});
         instances.Add(model);
     }
 
@@ -385,6 +422,7 @@ void ClientGameState::Render() {
     RenderPlanets(*this);
     RenderTanks(*this);
     RenderProjectiles(*this);
+    RenderTracers(*this);
     RenderHealthBars(*this);
     RenderFuel(*this);
     RenderAimGuide(*this);
@@ -4,6 +4,7 @@
 #include "client/graphics/graphics_manager.hpp"
 #include "common/log.hpp"
 #include "client/client_game_state.hpp"
+#include "common/replication.hpp"
 #include "common/log.hpp"
 #include "common/frame_timer.hpp"
 #include <iostream>
@@ -17,9 +18,13 @@ public:
     void Begin() override {
         this->net_message_handlers.Add<NetMessageType::LOAD_LEVEL>(&IngameState::HandleLoadLevelMessage, this);
         this->net_message_handlers.Add<NetMessageType::GAME_COMMAND>(&IngameState::HandleGameCommandMessage, this);
+        this->net_message_handlers.Add<NetMessageType::ENTITY_SNAPSHOT>(&IngameState::HandleEntitySnapshotMessage, this);
+        this->net_message_handlers.Add(&IngameState::HandleInputCommandMessage, this);
+        this->net_message_handlers.Add(&IngameState::HandleInputsConfirmedMessage, this);
         this->net_message_handlers.Add(&IngameState::HandleSetTickLengthMessage, this);
         this->net_message_handlers.Add(&IngameState::HandlePauseGameMessage, this);
         this->net_message_handlers.Add(&IngameState::HandlePingMessage, this);
+        this->net_message_handlers.Add(&IngameState::HandleTickStatsResponse, this);
         //this->net_message_handlers.add(&Ingame_State::handle_pong_message, this);
 
         auto &graphics_manager = GetGraphicsManager();
@@ -65,7 +70,20 @@ public:
     }
 
     void Tick(f32 dt) override {
-        this->game_state.Tick(dt);
+        if (!this->game_state.settings.deterministic) {
+            this->game_state.Tick(dt);
+            return;
+        }
+
+        // A tick without all of its inputs would diverge, so wait for the server to confirm it. The server is
+        // input_delay_ticks behind the confirmed tick, after a stall a few extra ticks per frame catch up with it.
+        for (u32 i = 0; i < MAX_TICKS_PER_FRAME && this->game_state.tick < this->confirmed_tick; ++i) {
+            this->game_state.Tick(dt);
+
+            if (this->game_state.tick + this->game_state.settings.input_delay_ticks >= this->confirmed_tick) {
+                break;
+            }
+        }
     }
 
     void Render() override {
@@ -101,6 +119,57 @@ public:
         }
     }
 
+    void HandleEntitySnapshotMessage(Packet &&packet) {
+        EntitySnapshotMessage message;
+        if (!message.Deserialize(packet) || message.id <= this->replication.latest_id) {
+            GetClient().ProtocolError();
+            return;
+        }
+
+        // The server only uses baselines that are still in its ring, ours holds the same ids
+        const ReplicationSnapshot *baseline = nullptr;
+        if (message.baseline != 0) {
+            baseline = this->replication.Get(message.baseline);
+
+            if (baseline == nullptr || message.id - message.baseline >= ReplicationHistory::CAPACITY) {
+                GetClient().ProtocolError();
+                return;
+            }
+        }
+
+        auto &snapshot = this->replication.Insert(message.id, message.tick);
+        if (!ReadSnapshotDelta(baseline, packet, snapshot) || !packet.IsValidAndFinished()) {
+            GetClient().ProtocolError();
+            return;
+        }
+
+        ApplySnapshot(snapshot, this->game_state.entities);
+
+        SnapshotAckMessage ack;
+        ack.id = message.id;
+        GetClient().Send(ack);
+    }
+
+    void HandleInputCommandMessage(InputCommandMessage &&message) {
+        if (message.tick < this->confirmed_tick) {
+            GetClient().ProtocolError();
+            return;
+        }
+
+        Array<char> command(sizeof(Packet_Header));
+        command.insert(command.end(), message.command.begin(), message.command.end());
+        this->game_state.QueueInput(message.tick, Entity{message.tank}, ToRvalue(command));
+    }
+
+    void HandleInputsConfirmedMessage(InputsConfirmedMessage &&message) {
+        if (message.tick < this->confirmed_tick) {
+            GetClient().ProtocolError();
+            return;
+        }
+
+        this->confirmed_tick = message.tick;
+    }
+
     void HandleSetTickLengthMessage(SetTickLengthMessage &&message) {
         auto &timer = GetFrameTimer();
         timer.tick_length_delta = chrono::microseconds{message.tick_length_delta_microseconds};
@@ -122,7 +191,17 @@ public:
         GetClient().Send(response);
     }
 
+    void HandleTickStatsResponse(TickStatsResponse &&message) {
+        for (const auto &summary : message.summaries) {
+            LogInfo("tick stats", FormatTickStats(summary));
+        }
+    }
+
+    constexpr static u32 MAX_TICKS_PER_FRAME = 4; // Deterministic mode, when catching up after a stall
+
     ClientGameState game_state;
+    ReplicationHistory replication; // Decoded entity snapshots, the baselines of the next deltas
+    u32 confirmed_tick = 0; // Deterministic mode: all inputs of the ticks before this one have arrived
 };
 
 UniquePtr<ClientState> client_states::MakeIngame(Entity my_tank) {
@@ -0,0 +1,223 @@
+#include "common/body_arrays.hpp"
+
+#include "common/gravity.hpp"
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#   define BODY_KERNEL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define BODY_KERNEL_SSE 1
+#endif
+
+// The strict path performs exactly the operations of GravityForce in the same order (no reciprocal
+// approximations, no fused multiply-add), so it produces the same bits as the pairwise registry loop.
+// The relaxed path drops the "/ dist * dist" which cancels out mathematically.
+
+void BodyArrays::Gather(EntityRegistry &registry) {
+    this->sources.entities.clear();
+    this->sources.x.clear();
+    this->sources.y.clear();
+    this->sources.mass.clear();
+    this->bodies.entities.clear();
+    this->bodies.x.clear();
+    this->bodies.y.clear();
+    this->bodies.velocity_x.clear();
+    this->bodies.velocity_y.clear();
+    this->bodies.mass.clear();
+    this->bodies.source_index.clear();
+
+    registry.View<CMass, CPosition>().each(
+        [&](Entity entity, CMass &mass, CPosition &position) {
+            auto source_index = this->sources.entities.size();
+            this->sources.entities.emplace_back(entity);
+            this->sources.x.emplace_back(position.value.x);
+            this->sources.y.emplace_back(position.value.y);
+            this->sources.mass.emplace_back(mass.value);
+
+            if (auto velocity = registry.TryGet<CVelocity>(entity)) {
+                this->bodies.entities.emplace_back(entity);
+                this->bodies.x.emplace_back(position.value.x);
+                this->bodies.y.emplace_back(position.value.y);
+                this->bodies.velocity_x.emplace_back(velocity->value.x);
+                this->bodies.velocity_y.emplace_back(velocity->value.y);
+                this->bodies.mass.emplace_back(mass.value);
+                this->bodies.source_index.emplace_back(static_cast<f32>(source_index));
+            }
+        });
+}
+
+void BodyArrays::Integrate(f32 dt) {
+    auto &bodies = this->bodies;
+    auto n = bodies.entities.size();
+    size_t i = 0;
+
+#if BODY_KERNEL_AVX
+    auto dt8 = _mm256_set1_ps(dt);
+
+    for (; i + 8 <= n; i += 8) {
+        auto x = _mm256_loadu_ps(&bodies.x[i]);
+        auto y = _mm256_loadu_ps(&bodies.y[i]);
+        auto velocity_x = _mm256_loadu_ps(&bodies.velocity_x[i]);
+        auto velocity_y = _mm256_loadu_ps(&bodies.velocity_y[i]);
+        _mm256_storeu_ps(&bodies.x[i], _mm256_add_ps(x, _mm256_mul_ps(velocity_x, dt8)));
+        _mm256_storeu_ps(&bodies.y[i], _mm256_add_ps(y, _mm256_mul_ps(velocity_y, dt8)));
+    }
+#elif BODY_KERNEL_SSE
+    auto dt4 = _mm_set1_ps(dt);
+
+    for (; i + 4 <= n; i += 4) {
+        auto x = _mm_loadu_ps(&bodies.x[i]);
+        auto y = _mm_loadu_ps(&bodies.y[i]);
+        auto velocity_x = _mm_loadu_ps(&bodies.velocity_x[i]);
+        auto velocity_y = _mm_loadu_ps(&bodies.velocity_y[i]);
+        _mm_storeu_ps(&bodies.x[i], _mm_add_ps(x, _mm_mul_ps(velocity_x, dt4)));
+        _mm_storeu_ps(&bodies.y[i], _mm_add_ps(y, _mm_mul_ps(velocity_y, dt4)));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        bodies.x[i] += bodies.velocity_x[i] * dt;
+        bodies.y[i] += bodies.velocity_y[i] * dt;
+    }
+
+    // The moved bodies are also sources for the gravity pass
+    for (i = 0; i < n; ++i) {
+        auto source_index = static_cast<size_t>(bodies.source_index[i]);
+        this->sources.x[source_index] = bodies.x[i];
+        this->sources.y[source_index] = bodies.y[i];
+    }
+}
+
+void BodyArrays::AccumulateGravity(f32 dt, bool strict) {
+    auto &bodies = this->bodies;
+    auto &sources = this->sources;
+    auto n = bodies.entities.size();
+    auto num_sources = sources.entities.size();
+    size_t i = 0;
+
+#if BODY_KERNEL_AVX
+    auto g = _mm256_set1_ps(gravitational_constant);
+    auto dt8 = _mm256_set1_ps(dt);
+
+    for (; i + 8 <= n; i += 8) {
+        auto x = _mm256_loadu_ps(&bodies.x[i]);
+        auto y = _mm256_loadu_ps(&bodies.y[i]);
+        auto mass = _mm256_loadu_ps(&bodies.mass[i]);
+        auto self = _mm256_loadu_ps(&bodies.source_index[i]);
+        auto g_mass = _mm256_mul_ps(g, mass);
+        auto force_x = _mm256_setzero_ps();
+        auto force_y = _mm256_setzero_ps();
+
+        for (size_t j = 0; j < num_sources; ++j) {
+            auto source_mass = _mm256_set1_ps(sources.mass[j]);
+            auto diff_x = _mm256_sub_ps(_mm256_set1_ps(sources.x[j]), x);
+            auto diff_y = _mm256_sub_ps(_mm256_set1_ps(sources.y[j]), y);
+            __m256 pair_x;
+            __m256 pair_y;
+
+            if (strict) {
+                auto dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(diff_x, diff_x), _mm256_mul_ps(diff_y, diff_y)));
+                pair_x = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(g, diff_x), mass), source_mass), dist), dist);
+                pair_y = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(g, diff_y), mass), source_mass), dist), dist);
+            } else {
+                auto factor = _mm256_mul_ps(g_mass, source_mass);
+                pair_x = _mm256_mul_ps(diff_x, factor);
+                pair_y = _mm256_mul_ps(diff_y, factor);
+            }
+
+            // Skip the body itself, keep the old sum instead of adding zero so even -0.0f survives
+            auto is_self = _mm256_cmp_ps(self, _mm256_set1_ps(static_cast<f32>(j)), _CMP_EQ_OQ);
+            force_x = _mm256_blendv_ps(_mm256_add_ps(force_x, pair_x), force_x, is_self);
+            force_y = _mm256_blendv_ps(_mm256_add_ps(force_y, pair_y), force_y, is_self);
+        }
+
+        _mm256_storeu_ps(&bodies.velocity_x[i], _mm256_add_ps(_mm256_loadu_ps(&bodies.velocity_x[i]), _mm256_mul_ps(force_x, dt8)));
+        _mm256_storeu_ps(&bodies.velocity_y[i], _mm256_add_ps(_mm256_loadu_ps(&bodies.velocity_y[i]), _mm256_mul_ps(force_y, dt8)));
+    }
+#elif BODY_KERNEL_SSE
+    auto g = _mm_set1_ps(gravitational_constant);
+    auto dt4 = _mm_set1_ps(dt);
+
+    for (; i + 4 <= n; i += 4) {
+        auto x = _mm_loadu_ps(&bodies.x[i]);
+        auto y = _mm_loadu_ps(&bodies.y[i]);
+        auto mass = _mm_loadu_ps(&bodies.mass[i]);
+        auto self = _mm_loadu_ps(&bodies.source_index[i]);
+        auto g_mass = _mm_mul_ps(g, mass);
+        auto force_x = _mm_setzero_ps();
+        auto force_y = _mm_setzero_ps();
+
+        for (size_t j = 0; j < num_sources; ++j) {
+            auto source_mass = _mm_set1_ps(sources.mass[j]);
+            auto diff_x = _mm_sub_ps(_mm_set1_ps(sources.x[j]), x);
+            auto diff_y = _mm_sub_ps(_mm_set1_ps(sources.y[j]), y);
+            __m128 pair_x;
+            __m128 pair_y;
+
+            if (strict) {
+                auto dist = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(diff_x, diff_x), _mm_mul_ps(diff_y, diff_y)));
+                pair_x = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(g, diff_x), mass), source_mass), dist), dist);
+                pair_y = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(g, diff_y), mass), source_mass), dist), dist);
+            } else {
+                auto factor = _mm_mul_ps(g_mass, source_mass);
+                pair_x = _mm_mul_ps(diff_x, factor);
+                pair_y = _mm_mul_ps(diff_y, factor);
+            }
+
+            // SSE2 has no blend, select with masks
+            auto is_self = _mm_cmpeq_ps(self, _mm_set1_ps(static_cast<f32>(j)));
+            force_x = _mm_or_ps(_mm_and_ps(is_self, force_x), _mm_andnot_ps(is_self, _mm_add_ps(force_x, pair_x)));
+            force_y = _mm_or_ps(_mm_and_ps(is_self, force_y), _mm_andnot_ps(is_self, _mm_add_ps(force_y, pair_y)));
+        }
+
+        _mm_storeu_ps(&bodies.velocity_x[i], _mm_add_ps(_mm_loadu_ps(&bodies.velocity_x[i]), _mm_mul_ps(force_x, dt4)));
+        _mm_storeu_ps(&bodies.velocity_y[i], _mm_add_ps(_mm_loadu_ps(&bodies.velocity_y[i]), _mm_mul_ps(force_y, dt4)));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        Vec2 position{bodies.x[i], bodies.y[i]};
+        Vec2 force{};
+        auto self = static_cast<size_t>(bodies.source_index[i]);
+
+        for (size_t j = 0; j < num_sources; ++j) {
+            if (j == self) {
+                continue;
+            }
+
+            auto diff = Vec2{sources.x[j], sources.y[j]} - position;
+
+            if (strict) {
+                force += GravityForce(diff, bodies.mass[i], sources.mass[j]);
+            } else {
+                force += diff * (gravitational_constant * bodies.mass[i] * sources.mass[j]);
+            }
+        }
+
+        bodies.velocity_x[i] += force.x * dt;
+        bodies.velocity_y[i] += force.y * dt;
+    }
+}
+
+void BodyArrays::ScatterPositions(EntityRegistry &registry) const {
+    for (size_t i = 0; i < this->bodies.entities.size(); ++i) {
+        registry.Get<CPosition>(this->bodies.entities[i]).value = Vec2{this->bodies.x[i], this->bodies.y[i]};
+    }
+}
+
+void BodyArrays::ScatterVelocities(EntityRegistry &registry) const {
+    for (size_t i = 0; i < this->bodies.entities.size(); ++i) {
+        registry.Get<CVelocity>(this->bodies.entities[i]).value = Vec2{this->bodies.velocity_x[i], this->bodies.velocity_y[i]};
+    }
+}
+
+StringView GetBodyKernelName() {
+#if BODY_KERNEL_AVX
+    return "avx";
+#elif BODY_KERNEL_SSE
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
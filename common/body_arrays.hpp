@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+// Dense structure-of-arrays mirror of the CPosition/CVelocity/CMass components.
+// Sources are all entities with a mass in View<CMass, CPosition> order (this is the order the
+// pairwise loop sums in), bodies are the sources that also have a velocity.
+struct BodyArrays {
+    void Gather(EntityRegistry &registry);
+    void Integrate(f32 dt);
+    void AccumulateGravity(f32 dt, bool strict); // Adds force * dt to the velocities
+    void ScatterPositions(EntityRegistry &registry) const;
+    void ScatterVelocities(EntityRegistry &registry) const;
+
+    struct {
+        Array<Entity> entities;
+        Array<f32> x;
+        Array<f32> y;
+        Array<f32> mass;
+    } sources;
+
+    struct {
+        Array<Entity> entities;
+        Array<f32> x;
+        Array<f32> y;
+        Array<f32> velocity_x;
+        Array<f32> velocity_y;
+        Array<f32> mass;
+        Array<f32> source_index; // Stored as float so the SIMD kernels can compare it directly, exact up to 2^24
+    } bodies;
+};
+
+StringView GetBodyKernelName();
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+#include <unordered_set>
+
+// Structural changes recorded while the systems iterate, GameState::FlushCommands applies them at the end of the tick
+struct CommandBuffer {
+    inline void Destroy(Entity entity) {
+        if (this->destroyed_set.insert(entity).second) {
+            this->destroyed.emplace_back(entity);
+        }
+    }
+
+    inline bool IsEmpty() const {
+        return this->destroyed.empty();
+    }
+
+    inline void Clear() {
+        this->destroyed.clear();
+        this->destroyed_set.clear();
+    }
+
+    Array<Entity> destroyed; // In the order of the Destroy calls
+    std::unordered_set<Entity> destroyed_set; // So that repeated Destroy calls record an entity once
+};
@@ -39,6 +39,8 @@ using Array = std::vector<T>;
 template<typename T>
 using UniquePtr = std::unique_ptr<T>;
 template<typename T>
+using SharedPtr = std::shared_ptr<T>;
+template<typename T>
 using Optional = std::optional<T>;
 
 template<typename T>
@@ -3,6 +3,7 @@
 #include "common.hpp"
 #include "packet.hpp"
 #include "log.hpp"
+#include "fixed.hpp"
 
 #include <random>
 #include <entt/entt.hpp>
@@ -77,6 +78,15 @@ struct CVelocity {
     Vec2 value;
 };
 
+// Moved by a system instead of being integrated: planets orbit analytically, tanks stick to their planet.
+// The dynamic body loops exclude these, the planets reach the gravity solvers as GameState::kinematic_sources.
+struct CKinematic {};
+
+// Position at the start of the tick, the collision test sweeps from here to CPosition
+struct CPreviousPosition {
+    Vec2 value;
+};
+
 struct CMass {
     f32 value;
 };
@@ -102,6 +112,7 @@ struct Weapon {
     };
 
     constexpr static f32 MAX_CHARGE = 60.0f;
+    constexpr static f32 HITSCAN_RANGE = 1500.0f; // Length of a traced round, see SimSettings::hitscan_machinegun
 
     f32 projectile_mass;
     f32 cooldown;
@@ -143,6 +154,14 @@ struct CPlanetPosition {
     f32 value;
 };
 
+// Cached world position of a tank, GameState::UpdateWorldTransforms refreshes it once per tick
+struct CWorldTransform {
+    Vec2 position{};
+    Vec2 offset{}; // From the planet center, only recomputed when the tank moved on its planet
+    Entity planet = entt::null;
+    f32 planet_position = 0.0f;
+};
+
 struct CCharging {
     f32 start_time = 0.0f;
 };
@@ -153,16 +172,22 @@ struct CProjectile {
     f32 impact_damage = 0.0f;
     f32 hit_radius = 40.0f;
     f32 radius = 7.0f;
+    u32 rewind_ticks = 0; // Lag compensation, tanks are hit where the shooter saw them this many ticks ago
 };
 
 struct CTimeToLiveBeforeExplosion {
     f32 value;
 };
 
-struct CNetReplication {
-    f32 last_replication;
+// Authoritative position and velocity in the deterministic mode, CPosition/CVelocity are derived from it
+struct CFixedBody {
+    FixedVec2 position;
+    FixedVec2 velocity;
 };
 
+// Entities whose state the server replicates to the clients, see ReplicationSnapshot
+struct CNetReplication {};
+
 enum class EntityPrefabId {
     PLANET,
     TANK,
@@ -187,13 +212,14 @@ inline Entity CreateEntity(EntityRegistry &registry, EntityPrefabId id, Optional
     switch (id) {
         case EntityPrefabId::PLANET: {
             registry.Add<CPlanet>(entity);
+            registry.Add<CKinematic>(entity);
             registry.Add<CPosition>(entity);
             registry.Add<CMass>(entity);
-            registry.Add<CNetReplication>(entity);
         } break;
 
         case EntityPrefabId::TANK: {
             registry.Add<CTank>(entity);
+            registry.Add<CKinematic>(entity);
             registry.Add<CPlanetPosition>(entity);
             registry.Add<CHealth>(entity);
             registry.Add<CNetReplication>(entity);
@@ -201,6 +227,7 @@ inline Entity CreateEntity(EntityRegistry &registry, EntityPrefabId id, Optional
 
         case EntityPrefabId::PROJECTILE: {
             registry.Add<CPosition>(entity);
+            registry.Add<CPreviousPosition>(entity);
             registry.Add<CVelocity>(entity);
             registry.Add<CMass>(entity);
             registry.Add<CProjectile>(entity);
@@ -215,6 +242,28 @@ inline Entity CreateEntity(EntityRegistry &registry, EntityPrefabId id, Optional
     return entity;
 }
 
+// Component values shared by a batch of projectiles, only the velocities differ
+struct ProjectilePrototype {
+    Vec2 position{};
+    f32 mass = 0.0f;
+    f32 ttl = 0.0f;
+    CProjectile projectile{};
+};
+
+// Batch version of CreateEntity(PROJECTILE), every pool is touched once for the whole batch.
+// entt recycles the ids of destroyed entities and the pools keep their capacity, so once the
+// pools have grown this doesn't allocate anymore.
+inline void CreateProjectiles(EntityRegistry &registry, Entity *first, Entity *last, const ProjectilePrototype &prototype, const CVelocity *velocities) {
+    registry.impl.create(first, last);
+    registry.impl.insert<CPosition>(first, last, CPosition{prototype.position});
+    registry.impl.insert<CPreviousPosition>(first, last, CPreviousPosition{prototype.position});
+    registry.impl.insert<CVelocity>(first, last, velocities, velocities + (last - first));
+    registry.impl.insert<CMass>(first, last, CMass{prototype.mass});
+    registry.impl.insert<CProjectile>(first, last, prototype.projectile);
+    registry.impl.insert<CTimeToLiveBeforeExplosion>(first, last, CTimeToLiveBeforeExplosion{prototype.ttl});
+    registry.impl.insert<CNetReplication>(first, last);
+}
+
 inline void SerializeEntities(const EntityRegistry &registry, Packet &packet) {
     auto archive = [&](const auto &...data) {
         (packet.WriteData(&data, sizeof(data)), ...);
@@ -231,7 +280,9 @@ inline void SerializeEntities(const EntityRegistry &registry, Packet &packet) {
         CTank,
         CPlanetPosition,
         CCharging,
-        CProjectile
+        CProjectile,
+        CFixedBody,
+        CKinematic
         >(archive);
 }
 
@@ -251,43 +302,98 @@ inline bool DeserializeEntities(EntityRegistry &registry, Packet &packet) {
         CTank,
         CPlanetPosition,
         CCharging,
-        CProjectile
+        CProjectile,
+        CFixedBody,
+        CKinematic
         >(archive);
     loader.orphans();
 
     return packet.IsValidAndFinished();
 }
 
+// Creates all component pools up front, entt creates them lazily on first access which is not thread safe
+inline void PrepareComponentPools(EntityRegistry &registry) {
+    registry.View<CPosition>();
+    registry.View<CPreviousPosition>();
+    registry.View<CVelocity>();
+    registry.View<CMass>();
+    registry.View<CHealth>();
+    registry.View<CPlanet>();
+    registry.View<CTank>();
+    registry.View<CPlanetPosition>();
+    registry.View<CCharging>();
+    registry.View<CProjectile>();
+    registry.View<CTimeToLiveBeforeExplosion>();
+    registry.View<CFixedBody>();
+    registry.View<CWorldTransform>();
+    registry.View<CKinematic>();
+    registry.View<CNetReplication>();
+}
+
+// Type erased access to a component pool, CloneRegistry and RegistrySnapshot copy the pools through this.
+// Every component has to be listed in g_component_pools.
+struct ComponentPool {
+    size_t component_size = 0; // 0 for empty components
+    size_t (*size)(const EntityRegistry &registry) = nullptr;
+    const Entity *(*entities)(const EntityRegistry &registry) = nullptr; // Packed, in pool order
+    const void *(*components)(const EntityRegistry &registry) = nullptr; // Null for empty components
+    void (*insert)(EntityRegistry &registry, const Entity *first, const Entity *last, const void *components) = nullptr;
+};
+
 template<typename Type>
-void CloneComponents(const EntityRegistry &from, EntityRegistry &to) {
-    auto data = from.impl.data<Type>();
-    auto size = from.impl.size<Type>();
+ComponentPool MakeComponentPool() {
+    // Snapshots store the components as plain bytes in u64 words
+    static_assert(std::is_trivially_copyable_v<Type>);
+    static_assert(alignof(Type) <= alignof(u64));
+
+    ComponentPool res;
+    res.size = [](const EntityRegistry &registry) { return registry.impl.size<Type>(); };
+    res.entities = [](const EntityRegistry &registry) { return registry.impl.data<Type>(); };
 
     if constexpr (ENTT_IS_EMPTY(Type)) {
-        to.impl.insert<Type>(data, data + size);
+        res.components = [](const EntityRegistry &registry) -> const void * { return nullptr; };
+        res.insert = [](EntityRegistry &registry, const Entity *first, const Entity *last, const void *components) {
+            registry.impl.insert<Type>(first, last);
+        };
     } else {
-        auto raw = from.impl.raw<Type>();
-        to.impl.insert<Type>(data, data + size, raw, raw + size);
+        res.component_size = sizeof(Type);
+        res.components = [](const EntityRegistry &registry) -> const void * { return registry.impl.raw<Type>(); };
+        res.insert = [](EntityRegistry &registry, const Entity *first, const Entity *last, const void *components) {
+            auto raw = static_cast<const Type *>(components);
+            registry.impl.insert<Type>(first, last, raw, raw + (last - first));
+        };
     }
+
+    return res;
 }
 
-using clone_fn_type = void(const EntityRegistry &, EntityRegistry &);
-inline const std::unordered_map<EntityId, clone_fn_type *> g_clone_functions = {
-    std::make_pair(entt::type_info<CPosition>::id(), &CloneComponents<CPosition>),
-    std::make_pair(entt::type_info<CVelocity>::id(), &CloneComponents<CVelocity>),
-    std::make_pair(entt::type_info<CMass>::id(), &CloneComponents<CMass>),
-    std::make_pair(entt::type_info<CHealth>::id(), &CloneComponents<CHealth>),
-    std::make_pair(entt::type_info<CPlanet>::id(), &CloneComponents<CPlanet>),
-    std::make_pair(entt::type_info<CTank>::id(), &CloneComponents<CTank>),
-    std::make_pair(entt::type_info<CPlanetPosition>::id(), &CloneComponents<CPlanetPosition>),
-    std::make_pair(entt::type_info<CCharging>::id(), &CloneComponents<CCharging>),
-    std::make_pair(entt::type_info<CProjectile>::id(), &CloneComponents<CProjectile>),
-    std::make_pair(entt::type_info<CTimeToLiveBeforeExplosion>::id(), &CloneComponents<CTimeToLiveBeforeExplosion>),
-    std::make_pair(entt::type_info<CNetReplication>::id(), &CloneComponents<CNetReplication>),
+inline const std::unordered_map<EntityId, ComponentPool> g_component_pools = {
+    std::make_pair(entt::type_info<CPosition>::id(), MakeComponentPool<CPosition>()),
+    std::make_pair(entt::type_info<CPreviousPosition>::id(), MakeComponentPool<CPreviousPosition>()),
+    std::make_pair(entt::type_info<CVelocity>::id(), MakeComponentPool<CVelocity>()),
+    std::make_pair(entt::type_info<CMass>::id(), MakeComponentPool<CMass>()),
+    std::make_pair(entt::type_info<CHealth>::id(), MakeComponentPool<CHealth>()),
+    std::make_pair(entt::type_info<CPlanet>::id(), MakeComponentPool<CPlanet>()),
+    std::make_pair(entt::type_info<CTank>::id(), MakeComponentPool<CTank>()),
+    std::make_pair(entt::type_info<CPlanetPosition>::id(), MakeComponentPool<CPlanetPosition>()),
+    std::make_pair(entt::type_info<CCharging>::id(), MakeComponentPool<CCharging>()),
+    std::make_pair(entt::type_info<CProjectile>::id(), MakeComponentPool<CProjectile>()),
+    std::make_pair(entt::type_info<CTimeToLiveBeforeExplosion>::id(), MakeComponentPool<CTimeToLiveBeforeExplosion>()),
+    std::make_pair(entt::type_info<CFixedBody>::id(), MakeComponentPool<CFixedBody>()),
+    std::make_pair(entt::type_info<CWorldTransform>::id(), MakeComponentPool<CWorldTransform>()),
+    std::make_pair(entt::type_info<CKinematic>::id(), MakeComponentPool<CKinematic>()),
+    std::make_pair(entt::type_info<CNetReplication>::id(), MakeComponentPool<CNetReplication>()),
 };
 
+// Replaces everything in to. The entity list (ids, versions and the free list) is assigned as a whole,
+// then every pool is inserted as one range.
 inline void CloneRegistry(const EntityRegistry &from, EntityRegistry &to) {
+    to.impl.clear();
+    to.impl.assign(from.impl.data(), from.impl.data() + from.impl.size(), from.impl.destroyed());
+
     from.impl.visit([&](auto type_id) {
-        g_clone_functions.at(type_id)(from, to);
+        const auto &pool = g_component_pools.at(type_id);
+        auto entities = pool.entities(from);
+        pool.insert(to, entities, entities + pool.size(from), pool.components(from));
     });
 }
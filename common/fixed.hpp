@@ -0,0 +1,156 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// 32.32 fixed point number for the deterministic simulation mode.
+// Everything in here is integer math (the float conversions are exact or IEEE rounded), so every
+// platform and compiler produces the same bits.
+struct Fixed {
+    constexpr static i32 fraction_bits = 32;
+    constexpr static i64 one = i64{1} << fraction_bits;
+
+    constexpr static Fixed FromRaw(i64 raw) {
+        Fixed res;
+        res.raw = raw;
+        return res;
+    }
+
+    constexpr static Fixed FromInt(i64 value) {
+        return FromRaw(value * one);
+    }
+
+    static Fixed FromFloat(f32 value) {
+        return FromRaw(static_cast<i64>(static_cast<f64>(value) * static_cast<f64>(one)));
+    }
+
+    inline f32 ToFloat() const {
+        return static_cast<f32>(static_cast<f64>(this->raw) / static_cast<f64>(one));
+    }
+
+    // Rounds towards zero. Done by hand instead of with __int128 so that MSVC gets the same result.
+    constexpr static i64 MulRaw(i64 a, i64 b) {
+        auto negative = (a < 0) != (b < 0);
+        auto ua = static_cast<u64>(a < 0 ? -a : a);
+        auto ub = static_cast<u64>(b < 0 ? -b : b);
+        auto a_hi = ua >> 32;
+        auto a_lo = ua & 0xFFFFFFFFu;
+        auto b_hi = ub >> 32;
+        auto b_lo = ub & 0xFFFFFFFFu;
+        auto res = ((a_hi * b_hi) << 32) + a_hi * b_lo + a_lo * b_hi + ((a_lo * b_lo) >> 32);
+        return negative ? -static_cast<i64>(res) : static_cast<i64>(res);
+    }
+
+    constexpr Fixed operator+(Fixed other) const { return FromRaw(this->raw + other.raw); }
+    constexpr Fixed operator-(Fixed other) const { return FromRaw(this->raw - other.raw); }
+    constexpr Fixed operator-() const { return FromRaw(-this->raw); }
+    constexpr Fixed operator*(Fixed other) const { return FromRaw(MulRaw(this->raw, other.raw)); }
+    constexpr Fixed operator/(i64 divisor) const { return FromRaw(this->raw / divisor); }
+    constexpr Fixed &operator+=(Fixed other) { this->raw += other.raw; return *this; }
+    constexpr Fixed &operator-=(Fixed other) { this->raw -= other.raw; return *this; }
+    constexpr bool operator==(Fixed other) const { return this->raw == other.raw; }
+    constexpr bool operator<(Fixed other) const { return this->raw < other.raw; }
+    constexpr bool operator>(Fixed other) const { return this->raw > other.raw; }
+
+    i64 raw = 0;
+};
+
+struct FixedVec2 {
+    static FixedVec2 FromVec2(Vec2 value) {
+        return FixedVec2{Fixed::FromFloat(value.x), Fixed::FromFloat(value.y)};
+    }
+
+    inline Vec2 ToVec2() const {
+        return Vec2{this->x.ToFloat(), this->y.ToFloat()};
+    }
+
+    constexpr FixedVec2 operator+(FixedVec2 other) const { return FixedVec2{this->x + other.x, this->y + other.y}; }
+    constexpr FixedVec2 operator-(FixedVec2 other) const { return FixedVec2{this->x - other.x, this->y - other.y}; }
+    constexpr FixedVec2 operator*(Fixed factor) const { return FixedVec2{this->x * factor, this->y * factor}; }
+    constexpr FixedVec2 operator/(i64 divisor) const { return FixedVec2{this->x / divisor, this->y / divisor}; }
+    constexpr FixedVec2 &operator+=(FixedVec2 other) { this->x += other.x; this->y += other.y; return *this; }
+
+    Fixed x;
+    Fixed y;
+};
+
+constexpr Fixed fixed_pi = Fixed::FromRaw(13493037705); // pi * 2^32
+constexpr Fixed fixed_half_pi = Fixed::FromRaw(fixed_pi.raw / 2);
+constexpr Fixed fixed_two_pi = Fixed::FromRaw(fixed_pi.raw * 2);
+
+inline Fixed FixedSin(Fixed radians) {
+    // Wrap to [-pi, pi]
+    auto x = Fixed::FromRaw(radians.raw % fixed_two_pi.raw);
+    if (x > fixed_pi) {
+        x -= fixed_two_pi;
+    } else if (x < -fixed_pi) {
+        x += fixed_two_pi;
+    }
+
+    // Mirror to [-pi/2, pi/2]
+    if (x > fixed_half_pi) {
+        x = fixed_pi - x;
+    } else if (x < -fixed_half_pi) {
+        x = -fixed_pi - x;
+    }
+
+    // Taylor series up to x^13, the error at pi/2 is below float precision
+    auto x2 = x * x;
+    auto term = x;
+    auto res = x;
+
+    for (i64 k = 1; k <= 6; ++k) {
+        term = -(term * x2) / ((2 * k) * (2 * k + 1));
+        res += term;
+    }
+
+    return res;
+}
+
+inline Fixed FixedCos(Fixed radians) {
+    return FixedSin(radians + fixed_half_pi);
+}
+
+inline FixedVec2 FixedRotate(FixedVec2 v, Fixed radians) {
+    auto sin = FixedSin(radians);
+    auto cos = FixedCos(radians);
+    return FixedVec2{v.x * cos - v.y * sin, v.x * sin + v.y * cos};
+}
+
+// Replacements for the libm functions, whose results differ between platforms
+inline f32 DeterministicSin(f32 radians) {
+    return FixedSin(Fixed::FromFloat(radians)).ToFloat();
+}
+
+inline f32 DeterministicCos(f32 radians) {
+    return FixedCos(Fixed::FromFloat(radians)).ToFloat();
+}
+
+inline Vec2 DeterministicRotate(Vec2 v, f32 radians) {
+    return FixedRotate(FixedVec2::FromVec2(v), Fixed::FromFloat(radians)).ToVec2();
+}
+
+// splitmix64, unlike std::mt19937 together with the std distributions the results are the same everywhere
+struct DeterministicRng {
+    explicit DeterministicRng(u64 seed)
+        : state(seed) {
+    }
+
+    inline u64 Next() {
+        auto z = (this->state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    inline f32 Uniform(f32 min, f32 max) {
+        // 24 random bits fit exactly into the float mantissa
+        auto unit = static_cast<f32>(this->Next() >> 40) * (1.0f / 16777216.0f);
+        return min + (max - min) * unit;
+    }
+
+    u64 state;
+};
+
+inline u64 HashCombine(u64 seed, u64 value) {
+    return DeterministicRng{seed ^ (value * 0x9E3779B97F4A7C15ull)}.Next();
+}
@@ -3,6 +3,7 @@
 #include "common/entity.hpp"
 #include "common/net_msg.hpp"
 #include "common/log.hpp"
+#include "common/worker_pool.hpp"
 
 #if CLIENT
 #include "client/client.hpp"
@@ -16,6 +17,62 @@
 #include "server/session.hpp"
 #endif // SERVER
 
+GameState::GameState() {
+    // Registration order is the execution order wherever the access sets overlap
+    this->scheduler.Add({"apply inputs", 0, 0, true, &GameState::TickApplyInputs});
+    this->scheduler.Add({"machinegun", 0, 0, true, &GameState::TickMachinegun});
+    this->scheduler.Add({
+        "integrate",
+        components<CVelocity, CMass, CPlanet, CProjectile, CKinematic>,
+        components<CPosition, CPreviousPosition, CFixedBody> |
+            system_resource::BODY_ARRAYS | system_resource::SUBSTEPS | system_resource::KINEMATIC,
+        false,
+        &GameState::TickIntegrate});
+    this->scheduler.Add({
+        "move tanks",
+        components<CPlanet>,
+        components<CPlanetPosition, CTank>,
+        false,
+        &GameState::TickMoveTanks});
+    this->scheduler.Add({"turret rotation", 0, components<CTank>, false, &GameState::TickTurretRotation});
+    this->scheduler.Add({
+        "gravity",
+        components<CMass, CKinematic> | system_resource::KINEMATIC,
+        components<CPosition, CVelocity, CFixedBody> |
+            system_resource::BODY_ARRAYS | system_resource::GRAVITY_TREE | system_resource::GRAVITY_FIELD,
+        false,
+        &GameState::TickGravity});
+    this->scheduler.Add({
+        "finish integrate",
+        components<CMass, CKinematic> | system_resource::KINEMATIC,
+        components<CPosition, CVelocity> | system_resource::SUBSTEPS,
+        false,
+        &GameState::TickFinishIntegrate});
+    this->scheduler.Add({"planet orbit", components<CPlanet>, components<CPosition, CFixedBody>, false, &GameState::TickPlanetOrbit});
+    this->scheduler.Add({
+        "world transforms",
+        components<CTank, CPlanet, CPlanetPosition, CPosition>,
+        components<CWorldTransform>,
+        false,
+        &GameState::TickWorldTransforms});
+    this->scheduler.Add({
+        "record history",
+        components<CTank, CWorldTransform>,
+        system_resource::TANK_HISTORY,
+        false,
+        &GameState::TickRecordHistory});
+    this->scheduler.Add({
+        "broadphase",
+        components<CTank, CHealth, CPlanet, CPosition, CWorldTransform>,
+        system_resource::BROADPHASE,
+        false,
+        &GameState::TickBroadphase});
+    this->scheduler.Add({"collision", 0, 0, true, &GameState::TickCollision});
+    this->scheduler.Add({"time to live", 0, 0, true, &GameState::TickTimeToLive});
+    this->scheduler.Add({"dead entities", 0, 0, true, &GameState::TickDeadEntities});
+    this->scheduler.Add({"flush commands", 0, 0, true, &GameState::TickFlushCommands});
+}
+
 void GameState::Tick(f32 dt) {
     //LogDebug("game_state time", "{}"_format(this->time));
     this->time += dt;
@@ -31,21 +88,117 @@ void GameState::Tick(f32 dt) {
     }
 #endif // CLIENT
 
-#ifdef SERVER
+    // Systems on other threads must not create pools
+    PrepareComponentPools(this->entities);
+    this->scheduler.Run(*this, dt, this->worker_pool);
+
+    ++this->tick;
+}
+
+void GameState::TickApplyInputs(f32 dt) {
+    if (!this->settings.deterministic) {
+        return;
+    }
+
+    this->ApplyPendingInputs();
+
+    // Planets get their fixed point body here, the snapshot from the server only has the float position
+    this->entities.View<CPlanet>(entt::exclude<CFixedBody>).each(
+        [&](Entity entity, CPlanet &planet) {
+            this->entities.Add<CFixedBody>(entity, FixedVec2::FromVec2(this->entities.Get<CPosition>(entity).value));
+        });
+}
+
+void GameState::TickMachinegun(f32 dt) {
+    this->hitscan_shots.clear();
+
+    if (!this->RunsGameplay()) {
+        return;
+    }
+
+    auto hitscan = this->settings.hitscan_machinegun && !this->settings.deterministic;
+
     this->entities.View<CTank, CCharging>().each(
         [&](Entity entity, CTank &tank, CCharging &charging) {
-            if (tank.weapon_type == Weapon::Type::MACHINEGUN) {
-                static_cast<ServerGameState *>(this)->FireProjectile(entity);
+            if (tank.weapon_type != Weapon::Type::MACHINEGUN) {
+                return;
+            }
+
+            if (!hitscan) {
+                this->FireProjectile(entity);
+                return;
             }
+
+            u32 rewind_ticks = 0;
+#if SERVER
+            rewind_ticks = static_cast<ServerGameState *>(this)->GetRewindTicks(entity);
+#endif // SERVER
+            this->FireHitscan(entity, rewind_ticks);
         });
-#endif
+}
 
-    // Update positions
-    this->entities.View<CPosition, CVelocity>().each(
-        [&](Entity entity, CPosition &position, CVelocity &velocity) {
-            position.value += velocity.value * dt;
+void GameState::TickIntegrate(f32 dt) {
+    // Update positions. The leapfrog only drifts half of the tick here and the other half in TickFinishIntegrate.
+    auto leapfrog = !this->settings.deterministic && this->settings.integrator == Integrator::LEAPFROG;
+    auto drift_dt = leapfrog ? dt / 2.0f : dt;
+
+    auto integrate = [&](Entity entity, CPosition &position, CVelocity &velocity) {
+        position.value += velocity.value * drift_dt;
+    };
+
+    this->entities.View<CPreviousPosition, CPosition>().each(
+        [&](Entity entity, CPreviousPosition &previous_position, CPosition &position) {
+            previous_position.value = position.value;
+        });
+
+    // The planets only move in the orbit system at the end of the tick, gather them once for all the per-body loops
+    this->kinematic_sources.clear();
+    this->kinematic_radii.clear();
+    this->entities.View<CPlanet, CMass, CPosition>().each(
+        [&](Entity entity, CPlanet &planet, CMass &mass, CPosition &position) {
+            this->kinematic_sources.emplace_back(GravitySource{position.value, mass.value, entity});
+            this->kinematic_radii.emplace_back(planet.radius);
         });
 
+    this->substep_bodies.clear();
+
+    if (leapfrog && this->settings.max_substeps > 1) {
+        // Remember where the projectiles close to a planet started, before the drift below moves them
+        this->entities.View<CProjectile, CPosition, CVelocity>().each(
+            [&](Entity entity, CProjectile &projectile, CPosition &position, CVelocity &velocity) {
+                auto is_close = false;
+
+                for (size_t i = 0; i < this->kinematic_sources.size() && !is_close; ++i) {
+                    auto radius = this->kinematic_radii[i] * this->settings.substep_radius;
+                    auto diff = position.value - this->kinematic_sources[i].position;
+                    is_close = glm::dot(diff, diff) < radius * radius;
+                }
+
+                if (is_close) {
+                    this->substep_bodies.emplace_back(SubstepBody{entity, position.value, velocity.value});
+                }
+            });
+    }
+
+    auto fixed_dt = Fixed::FromFloat(dt);
+
+    if (this->settings.deterministic) {
+        this->entities.View<CFixedBody, CVelocity>().each(
+            [&](Entity entity, CFixedBody &body, CVelocity &velocity) {
+                body.position += body.velocity * fixed_dt;
+            });
+    } else if (this->settings.simd_kernel) {
+        // Everything with a mass is moved by the SoA kernel, the gravity pass below reuses the gathered arrays
+        this->body_arrays.Gather(this->entities);
+        this->body_arrays.Integrate(drift_dt);
+        this->body_arrays.ScatterPositions(this->entities);
+        this->entities.View<CPosition, CVelocity>(entt::exclude<CMass, CKinematic>).each(integrate);
+    } else {
+        this->entities.View<CPosition, CVelocity>(entt::exclude<CKinematic>).each(integrate);
+    }
+}
+
+void GameState::TickMoveTanks(f32 dt) {
     // Move tanks
     this->entities.View<CPlanetPosition, CTank>().each(
         [&](Entity entity, CPlanetPosition &planet_position, CTank &tank) {
@@ -57,7 +210,9 @@ void GameState::Tick(f32 dt) {
                 //log_debug("fuel left", "{}"_format(tank.fuel));
             }
         });
+}
 
+void GameState::TickTurretRotation(f32 dt) {
     // Update turret rotations
     this->entities.View<CTank>().each(
         [&](Entity entity, CTank &tank) {
@@ -94,34 +249,157 @@ void GameState::Tick(f32 dt) {
             tank.turret_rotation = std::fmod(tank.turret_rotation, 360.0f);
             //assert(current >= 0.0f);
         });
+}
 
+void GameState::TickGravity(f32 dt) {
     // Gravity simulation
-    this->entities.View<CPosition, CVelocity, CMass>().each(
-        [&](
-            Entity moving_entity,
-            CPosition &moving_position,
-            CVelocity &moving_velocity,
-            CMass &moving_mass) {
-            Vec2 force{};
+    if (this->settings.deterministic) {
+        // Integer sums, so unlike the float solvers the iteration order doesn't change the result
+        this->fixed_gravity_sources.clear();
+        this->entities.View<CFixedBody, CMass>().each(
+            [&](Entity entity, CFixedBody &body, CMass &mass) {
+                this->fixed_gravity_sources.emplace_back(FixedGravitySource{body.position, Fixed::FromFloat(mass.value), entity});
+            });
 
+        this->entities.View<CFixedBody, CVelocity, CMass>(entt::exclude<CKinematic>).each(
+            [&](
+                Entity moving_entity,
+                CFixedBody &moving_body,
+                CVelocity &moving_velocity,
+                CMass &moving_mass) {
+                auto moving_fixed_mass = Fixed::FromFloat(moving_mass.value);
+                FixedVec2 force{};
+
+                for (const auto &source : this->fixed_gravity_sources) {
+                    if (source.entity != moving_entity) {
+                        force += FixedGravityForce(source.position - moving_body.position, moving_fixed_mass, source.mass);
+                    }
+                }
+
+                moving_body.velocity += force * Fixed::FromFloat(dt);
+                moving_velocity.value = moving_body.velocity.ToVec2();
+            });
+
+        this->entities.View<CFixedBody, CPosition, CVelocity>().each(
+            [&](Entity entity, CFixedBody &body, CPosition &position, CVelocity &velocity) {
+                position.value = body.position.ToVec2();
+            });
+    } else switch (this->settings.gravity_solver) {
+        case GravitySolver::EXACT: {
+            if (this->settings.simd_kernel) {
+                this->body_arrays.AccumulateGravity(dt, this->settings.strict_kernel);
+                this->body_arrays.ScatterVelocities(this->entities);
+                break;
+            }
+
+            // Same source order as the registry view, so the sums stay bit identical to the SIMD strict kernel
+            this->gravity_sources.clear();
             this->entities.View<CMass, CPosition>().each(
+                [&](Entity entity, CMass &mass, CPosition &position) {
+                    this->gravity_sources.emplace_back(GravitySource{position.value, mass.value, entity});
+                });
+
+            this->entities.View<CPosition, CVelocity, CMass>(entt::exclude<CKinematic>).each(
                 [&](
-                    Entity test_entity,
-                    CMass &test_mass,
-                    CPosition test_position) {
-                    if (test_entity == moving_entity) {
-                        return;
+                    Entity moving_entity,
+                    CPosition &moving_position,
+                    CVelocity &moving_velocity,
+                    CMass &moving_mass) {
+                    Vec2 force{};
+
+                    for (const auto &source : this->gravity_sources) {
+                        if (source.entity != moving_entity) {
+                            force += GravityForce(source.position - moving_position.value, moving_mass.value, source.mass);
+                        }
                     }
 
-                    auto diff = test_position.value - moving_position.value;
-                    auto dist = glm::length(diff);
-                    force += 0.0000001f * diff * moving_mass.value * test_mass.value / dist * dist;
+                    moving_velocity.value += force * dt;
                 });
+        } break;
 
-            moving_velocity.value += force;
+        case GravitySolver::BARNES_HUT: {
+            this->gravity_sources.clear();
+            this->entities.View<CMass, CPosition>().each(
+                [&](Entity entity, CMass &mass, CPosition &position) {
+                    this->gravity_sources.emplace_back(GravitySource{position.value, mass.value, entity});
+                });
+
+            this->gravity_tree.Build(this->gravity_sources);
+
+            this->entities.View<CPosition, CVelocity, CMass>(entt::exclude<CKinematic>).each(
+                [&](
+                    Entity moving_entity,
+                    CPosition &moving_position,
+                    CVelocity &moving_velocity,
+                    CMass &moving_mass) {
+                    moving_velocity.value += dt * this->gravity_tree.ComputeForce(
+                        moving_position.value,
+                        moving_mass.value,
+                        moving_entity,
+                        this->settings.barnes_hut_theta);
+                });
+        } break;
+
+        case GravitySolver::FIELD: {
+            // Planets only, the field doesn't contain the projectiles
+            this->gravity_field.Update(this->kinematic_sources, this->size, this->settings.field_max_error);
+
+            this->entities.View<CPosition, CVelocity, CMass>(entt::exclude<CKinematic>).each(
+                [&](
+                    Entity moving_entity,
+                    CPosition &moving_position,
+                    CVelocity &moving_velocity,
+                    CMass &moving_mass) {
+                    moving_velocity.value += this->gravity_field.ComputeForce(moving_position.value, moving_mass.value) * dt;
+                });
+        } break;
+
+        default:
+            UNREACHED;
+    }
+}
+
+void GameState::TickFinishIntegrate(f32 dt) {
+    if (this->settings.deterministic || this->settings.integrator != Integrator::LEAPFROG) {
+        return;
+    }
+
+    // Second half of the drift with the kicked velocities
+    auto half_dt = dt / 2.0f;
+
+    this->entities.View<CPosition, CVelocity>(entt::exclude<CKinematic>).each(
+        [&](Entity entity, CPosition &position, CVelocity &velocity) {
+            position.value += velocity.value * half_dt;
         });
 
-#if 1
+    // Redo the projectiles close to a planet from their start state in substeps. Only the planet force changes
+    // between the substeps, the kick from everything else is taken from the full step and spread evenly.
+    auto num_substeps = this->settings.max_substeps;
+    auto substep_dt = dt / static_cast<f32>(num_substeps);
+
+    for (const auto &body : this->substep_bodies) {
+        auto &position = this->entities.Get<CPosition>(body.entity);
+        auto &velocity = this->entities.Get<CVelocity>(body.entity);
+        auto mass = this->entities.Get<CMass>(body.entity).value;
+
+        auto midpoint = body.position + body.velocity * half_dt;
+        auto other_kick = (velocity.value - body.velocity - this->ComputePlanetForce(midpoint, mass) * dt) / static_cast<f32>(num_substeps);
+
+        auto substep_position = body.position;
+        auto substep_velocity = body.velocity;
+
+        for (u32 i = 0; i < num_substeps; ++i) {
+            substep_position += substep_velocity * (substep_dt / 2.0f);
+            substep_velocity += this->ComputePlanetForce(substep_position, mass) * substep_dt + other_kick;
+            substep_position += substep_velocity * (substep_dt / 2.0f);
+        }
+
+        position.value = substep_position;
+        velocity.value = substep_velocity;
+    }
+}
+
+void GameState::TickPlanetOrbit(f32 dt) {
     // Rotate planets around sun
     this->entities.View<CPlanet, CPosition>().each(
         [&](
@@ -129,55 +407,225 @@ void GameState::Tick(f32 dt) {
             CPlanet &planet,
             CPosition &position) {
             auto sun_position = this->size / 2.0f;
+
+            if (this->settings.deterministic) {
+                auto fixed_sun_position = FixedVec2::FromVec2(sun_position);
+                auto &body = this->entities.Get<CFixedBody>(planet_entity);
+                body.position = FixedRotate(FixedVec2::FromVec2(planet.initial_position) - fixed_sun_position, Fixed::FromFloat(this->time * planet.orbital_velocity)) + fixed_sun_position;
+                position.value = body.position.ToVec2();
+                return;
+            }
+
             position.value = glm::rotate(planet.initial_position - sun_position, this->time * planet.orbital_velocity) + sun_position;
         });
-#endif
+}
 
-#if SERVER
-    // Projectile collision checking
+void GameState::TickWorldTransforms(f32 dt) {
+    this->UpdateWorldTransforms();
+}
+
+void GameState::TickRecordHistory(f32 dt) {
+    if (this->settings.deterministic || this->settings.max_rewind_ticks == 0 || !this->RunsGameplay()) {
+        return;
+    }
+
+    auto &samples = this->tank_history.BeginFrame(this->tick, this->settings.max_rewind_ticks + 1);
+
+    this->entities.View<CTank, CWorldTransform>().each(
+        [&](Entity entity, CTank &tank, CWorldTransform &transform) {
+            samples.emplace_back(TransformHistory::Sample{entity, transform.position});
+        });
+
+    this->tank_history.EndFrame();
+}
+
+void GameState::TickBroadphase(f32 dt) {
+    this->UpdateBroadphase();
+}
+
+void GameState::TickCollision(f32 dt) {
+    if (!this->RunsGameplay()) {
+        return;
+    }
+
+    // Projectile collision checking. The projectiles sweep their path of this tick, so fast ones can't tunnel
+    // through a tank between two ticks. The first contact along the path wins. The hitscan rounds of the
+    // machinegun are the same test with a longer path.
+    this->projectile_hits.clear();
     this->entities.View<CProjectile, CPosition>().each(
-        [&](Entity projectile_entity, CProjectile &projectile, CPosition &projectile_position) {
+        [&](Entity projectile_entity, CProjectile &projectile, CPosition &position) {
+            this->projectile_hits.emplace_back(ProjectileHit{projectile_entity});
+        });
+
+    // Returns the first contact along the path, past 1 if there is none
+    auto trace = [&](Vec2 from, Vec2 to, f32 hit_radius, f32 radius, Entity firing_entity, u32 rewind_ticks, Entity &target, bool &is_tank) {
+        auto first_contact = 2.0f; // Past the end of the path
+
         // Projectile - Tank
-        this->entities.View<CTank, CHealth>().each(
-            [&](Entity tank_entity, CTank &tank, CHealth &health) {
-                if (tank_entity == projectile.firing_entity) {
-                    return;
-                }
+        rewind_ticks = std::min(rewind_ticks, this->tick);
+        auto past_tick = this->tick - rewind_ticks;
 
-                auto tank_position = this->GetTankWorldPosition(tank_entity);
-                auto diff = tank_position - projectile_position.value;
+        if (rewind_ticks > 0 && this->tank_history.GetFrame(past_tick) != nullptr) {
+            // The broadphase has the current positions, widen the query by how far the tanks could have moved since
+            auto slack = this->tank_history.GetMaxDisplacement(rewind_ticks);
 
-                if (diff.x * diff.x + diff.y * diff.y < projectile.hit_radius * projectile.hit_radius) {
-                    health.value -= projectile.impact_damage;
-                    this->DestroyEntity(projectile_entity);
+            this->broadphase.ForEachOnSegment(from, to, hit_radius + slack, GameState::COLLIDER_TANK,
+                [&](const SpatialHash::Entry &entry, f32) {
+                    if (entry.entity == firing_entity) {
+                        return;
+                    }
 
-                    SetHealthCommand command;
-                    command.target = entt::to_integral(tank_entity);
-                    command.health = health.value;
-                    command.max = health.max;
+                    auto past_position = this->tank_history.GetPosition(entry.entity, past_tick);
+                    if (!past_position.has_value()) {
+                        return;
+                    }
 
-                    GameCommandMessage message;
-                    Packet packet;
-                    message.Serialize(packet);
-                    this->SerializeCommand(command, packet);
-                    static_cast<ServerGameState *>(this)->session->BroadcastPacket(ToRvalue(packet));
-                }
-            });
+                    auto t = SweepCircle(from, to - from, past_position.value(), hit_radius);
+                    if (t.has_value() && t.value() < first_contact) {
+                        first_contact = t.value();
+                        target = entry.entity;
+                        is_tank = true;
+                    }
+                });
+        } else {
+            this->broadphase.ForEachOnSegment(from, to, hit_radius, GameState::COLLIDER_TANK,
+                [&](const SpatialHash::Entry &entry, f32 t) {
+                    if (entry.entity != firing_entity && t < first_contact) {
+                        first_contact = t;
+                        target = entry.entity;
+                        is_tank = true;
+                    }
+                });
+        }
 
         // Projectile - Planet
-        this->entities.View<CPlanet, CPosition>().each(
-            [&](Entity planet_entity, CPlanet &planet, CPosition &planet_position) {
-                auto diff = planet_position.value - projectile_position.value;
-                auto collision_radius = planet.radius + projectile.radius;
-
-                if (diff.x * diff.x + diff.y * diff.y < collision_radius * collision_radius) {
-                    this->DestroyEntity(projectile_entity);
+        this->broadphase.ForEachOnSegment(from, to, radius, GameState::COLLIDER_PLANET,
+            [&](const SpatialHash::Entry &entry, f32 t) {
+                if (t < first_contact) {
+                    first_contact = t;
+                    target = entry.entity;
+                    is_tank = false;
                 }
             });
+
+        return first_contact;
+    };
+
+    auto find_hit = [&](ProjectileHit &hit) {
+        const auto &projectile = this->entities.Get<CProjectile>(hit.projectile);
+        auto to = this->entities.Get<CPosition>(hit.projectile).value;
+        auto previous_position = this->entities.TryGet<CPreviousPosition>(hit.projectile);
+        auto from = previous_position != nullptr ? previous_position->value : to;
+        trace(from, to, projectile.hit_radius, projectile.radius, projectile.firing_entity, projectile.rewind_ticks, hit.target, hit.is_tank);
+    };
+
+    auto find_shot_hit = [&](HitscanShot &shot) {
+        auto first_contact = trace(shot.from, shot.to, CProjectile{}.hit_radius, 0.0f, shot.firing_entity, shot.rewind_ticks, shot.target, shot.is_tank);
+        shot.to = glm::mix(shot.from, shot.to, std::min(first_contact, 1.0f));
+    };
+
+    // Finding the hits only reads, this system runs alone so the pool is free. Projectiles and rounds are one batch.
+    constexpr size_t hits_per_job = 256;
+    auto num_hits = this->projectile_hits.size();
+    auto num_traces = num_hits + this->hitscan_shots.size();
+
+    auto find = [&](size_t i) {
+        if (i < num_hits) {
+            find_hit(this->projectile_hits[i]);
+        } else {
+            find_shot_hit(this->hitscan_shots[i - num_hits]);
+        }
+    };
+
+    if (this->worker_pool != nullptr && num_traces > hits_per_job) {
+        this->worker_pool->ParallelFor((num_traces + hits_per_job - 1) / hits_per_job, [&](size_t job) {
+            auto end = std::min(num_traces, (job + 1) * hits_per_job);
+            for (auto i = job * hits_per_job; i < end; ++i) {
+                find(i);
+            }
         });
-#endif // SERVER
+    } else {
+        for (size_t i = 0; i < num_traces; ++i) {
+            find(i);
+        }
+    }
+
+    // Applied in view order, the order doesn't depend on the threads
+    this->damaged_tanks.clear();
+
+    for (const auto &hit : this->projectile_hits) {
+        if (hit.target == entt::null) {
+            continue;
+        }
+
+        this->DestroyEntity(hit.projectile);
+
+        if (hit.is_tank) {
+            this->entities.Get<CHealth>(hit.target).value -= this->entities.Get<CProjectile>(hit.projectile).impact_damage;
+            this->damaged_tanks.emplace_back(hit.target);
+        }
+    }
+
+    for (const auto &shot : this->hitscan_shots) {
+        if (shot.target != entt::null && shot.is_tank) {
+            this->entities.Get<CHealth>(shot.target).value -= shot.damage;
+            this->damaged_tanks.emplace_back(shot.target);
+        }
+    }
 
 #if SERVER
+    if (this->settings.deterministic) {
+        // Every client computes the same hits
+        return;
+    }
+
+    auto session = static_cast<ServerGameState *>(this)->session;
+
+    // One update per tank, sustained fire hits the same tank several times per tick
+    std::sort(this->damaged_tanks.begin(), this->damaged_tanks.end());
+    this->damaged_tanks.erase(std::unique(this->damaged_tanks.begin(), this->damaged_tanks.end()), this->damaged_tanks.end());
+
+    for (auto tank : this->damaged_tanks) {
+        const auto &health = this->entities.Get<CHealth>(tank);
+
+        SetHealthCommand command;
+        command.target = entt::to_integral(tank);
+        command.health = health.value;
+        command.max = health.max;
+
+        GameCommandMessage message;
+        Packet packet;
+        message.Serialize(packet);
+        this->SerializeCommand(command, packet);
+        session->BroadcastPacket(ToRvalue(packet));
+    }
+
+    // The clients reject commands with more than MAX_TRACERS
+    for (size_t first = 0; first < this->hitscan_shots.size(); first += FireTracersCommand::MAX_TRACERS) {
+        auto last = std::min(this->hitscan_shots.size(), first + FireTracersCommand::MAX_TRACERS);
+
+        FireTracersCommand command;
+        command.tracers.reserve(last - first);
+
+        for (auto i = first; i < last; ++i) {
+            const auto &shot = this->hitscan_shots[i];
+            command.tracers.emplace_back(FireTracersCommand::Tracer{entt::to_integral(shot.firing_entity), shot.from, shot.to});
+        }
+
+        GameCommandMessage message;
+        Packet packet;
+        message.Serialize(packet);
+        this->SerializeCommand(command, packet);
+        session->BroadcastPacket(ToRvalue(packet));
+    }
+#endif // SERVER
+}
+
+void GameState::TickTimeToLive(f32 dt) {
+    if (!this->RunsGameplay()) {
+        return;
+    }
+
     // Check time to live before explosion
     this->entities.View<CTimeToLiveBeforeExplosion>().each(
         [&](Entity entity, CTimeToLiveBeforeExplosion &ttl) {
@@ -189,6 +637,12 @@ void GameState::Tick(f32 dt) {
             }
 
         });
+}
+
+void GameState::TickDeadEntities(f32 dt) {
+    if (!this->RunsGameplay()) {
+        return;
+    }
 
     // Destroy dead entities
     this->entities.View<CHealth>().each(
@@ -197,27 +651,8 @@ void GameState::Tick(f32 dt) {
                 this->DestroyEntity(entity);
             }
         });
+}
 
-#if 0
-    // Replicate entities
-    this->entities.view<Net_Replication_Component, Position_Component>().each([&](
-        Entity entity,
-        Net_Replication_Component &replication,
-        Position_Component &position) {
-            if (replication.last_replication + 30.0f < this->time) {
-                Set_Position_Command command;
-                command.target = entt::to_integral(entity);
-                command.position = position.value;
-                Game_Command_Message message;
-                Packet packet;
-                message.serialize(packet);
-                this->serialize_command(command, packet);
-                static_cast<Server_Game_State *>(this)->session->broadcast_packet(ToRvalue(packet));
-
-                replication.last_replication = this->time;
-            }
-        });
-#endif
-
-#endif // SERVER
+void GameState::TickFlushCommands(f32 dt) {
+    this->FlushCommands();
 }
@@ -75,6 +75,66 @@ bool DestroyEntityCommand::Deserialize(Packet &packet) {
         packet.ReadU32(this->target);
 }
 
+void DestroyEntitiesCommand::Serialize(Packet &packet) const {
+    packet.WriteU32(static_cast<u32>(this->targets.size()));
+
+    for (auto target : this->targets) {
+        packet.WriteU32(target);
+    }
+}
+
+bool DestroyEntitiesCommand::Deserialize(Packet &packet) {
+    u32 count = 0;
+
+    if (!packet.ReadU32(count) || count > MAX_TARGETS) {
+        return false;
+    }
+
+    this->targets.resize(count);
+
+    for (auto &target : this->targets) {
+        if (!packet.ReadU32(target)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FireTracersCommand::Serialize(Packet &packet) const {
+    packet.WriteU32(static_cast<u32>(this->tracers.size()));
+
+    for (const auto &tracer : this->tracers) {
+        packet.WriteU32(tracer.firing_entity);
+        packet.WriteF32(tracer.from.x);
+        packet.WriteF32(tracer.from.y);
+        packet.WriteF32(tracer.to.x);
+        packet.WriteF32(tracer.to.y);
+    }
+}
+
+bool FireTracersCommand::Deserialize(Packet &packet) {
+    u32 count = 0;
+
+    if (!packet.ReadU32(count) || count > MAX_TRACERS) {
+        return false;
+    }
+
+    this->tracers.resize(count);
+
+    for (auto &tracer : this->tracers) {
+        if (!packet.ReadU32(tracer.firing_entity) ||
+            !packet.ReadF32(tracer.from.x) ||
+            !packet.ReadF32(tracer.from.y) ||
+            !packet.ReadF32(tracer.to.x) ||
+            !packet.ReadF32(tracer.to.y)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void SetHealthCommand::Serialize(Packet &packet) const {
     packet.WriteU32(this->target);
     packet.WriteF32(this->health);
@@ -97,26 +157,55 @@ bool PlaySfxCommand::Deserialize(Packet &packet) {
         packet.ReadEnum(this->sfx);
 }
 
-void SetPositionCommand::Serialize(Packet &packet) const {
-    packet.WriteU32(this->target);
-    packet.WriteF32(this->position.x);
-    packet.WriteF32(this->position.y);
+void SwitchWeaponCommand::Serialize(Packet &packet) const {
+    packet.WriteEnum(this->weapon_type);
 }
 
-bool SetPositionCommand::Deserialize(Packet &packet) {
+bool SwitchWeaponCommand::Deserialize(Packet &packet) {
     return
-        packet.ReadU32(this->target) &&
-        packet.ReadF32(this->position.x) &&
-        packet.ReadF32(this->position.y);
+        packet.ReadEnum(this->weapon_type);
 }
 
-void SwitchWeaponCommand::Serialize(Packet &packet) const {
-    packet.WriteEnum(this->weapon_type);
+void SimSettings::Serialize(Packet &packet) const {
+    packet.WriteEnum(this->gravity_solver);
+    packet.WriteF32(this->barnes_hut_theta);
+    packet.WriteF32(this->field_max_error);
+    packet.WriteB8(this->simd_kernel);
+    packet.WriteB8(this->strict_kernel);
+    packet.WriteB8(this->deterministic);
+    packet.WriteU64(this->seed);
+    packet.WriteU32(this->input_delay_ticks);
+    packet.WriteEnum(this->integrator);
+    packet.WriteU32(this->max_substeps);
+    packet.WriteF32(this->substep_radius);
+    packet.WriteU32(this->tick_interval);
+    packet.WriteU32(this->max_rewind_ticks);
+    packet.WriteB8(this->hitscan_machinegun);
 }
 
-bool SwitchWeaponCommand::Deserialize(Packet &packet) {
+bool SimSettings::Deserialize(Packet &packet) {
     return
-        packet.ReadEnum(this->weapon_type);
+        packet.ReadEnum(this->gravity_solver) &&
+        this->gravity_solver < GravitySolver::COUNT &&
+        packet.ReadF32(this->barnes_hut_theta) &&
+        packet.ReadF32(this->field_max_error) &&
+        packet.ReadB8(this->simd_kernel) &&
+        packet.ReadB8(this->strict_kernel) &&
+        packet.ReadB8(this->deterministic) &&
+        packet.ReadU64(this->seed) &&
+        packet.ReadU32(this->input_delay_ticks) &&
+        packet.ReadEnum(this->integrator) &&
+        this->integrator < Integrator::COUNT &&
+        packet.ReadU32(this->max_substeps) &&
+        this->max_substeps >= 1 &&
+        this->max_substeps <= SimSettings::MAX_SUBSTEPS &&
+        packet.ReadF32(this->substep_radius) &&
+        packet.ReadU32(this->tick_interval) &&
+        this->tick_interval >= 1 &&
+        this->tick_interval <= SimSettings::MAX_TICK_INTERVAL &&
+        packet.ReadU32(this->max_rewind_ticks) &&
+        this->max_rewind_ticks <= SimSettings::MAX_REWIND_TICKS &&
+        packet.ReadB8(this->hitscan_machinegun);
 }
 
 bool GameState::HandleCommandPacket(const CommandContext &context, Packet &packet) {
@@ -143,20 +232,139 @@ bool GameState::HandleCommandPacket(const CommandContext &context, Packet &packe
         DO_COMMAND(DESTROY_ENTITY,   DestroyEntityCommand)
         DO_COMMAND(SET_HEALTH,       SetHealthCommand)
         DO_COMMAND(PLAY_SFX,         PlaySfxCommand)
-        DO_COMMAND(SET_POSITION,     SetPositionCommand)
         DO_COMMAND(SWITCH_WEAPON,    SwitchWeaponCommand)
+        DO_COMMAND(DESTROY_ENTITIES, DestroyEntitiesCommand)
+        DO_COMMAND(FIRE_TRACERS,     FireTracersCommand)
+        default:
+            return false;
+    }
+#undef DO_COMMAND
+}
+
+void GameState::QueueInput(u32 tick, Entity tank, Array<char> &&command) {
+    this->pending_inputs.emplace_back(PendingInput{tick, tank, ToRvalue(command)});
+}
+
+void GameState::ApplyPendingInputs() {
+    // Inputs are applied in the order they were queued, the server sends them in that order
+    auto it = std::stable_partition(this->pending_inputs.begin(), this->pending_inputs.end(),
+        [&](const PendingInput &input) {
+            return input.tick > this->tick;
+        });
+
+    for (auto input = it; input != this->pending_inputs.end(); ++input) {
+        // Clients only simulate the ticks the server confirmed, so no input can be late
+        assert(input->tick == this->tick);
+
+        Packet packet;
+        packet.Reset(ToRvalue(input->command));
+
+        if (!this->ApplyInputPacket(input->tank, packet) || !packet.IsValidAndFinished()) {
+            LogWarning("game_state", "Failed to apply input for tick {}"_format(input->tick));
+        }
+    }
+
+    this->pending_inputs.erase(it, this->pending_inputs.end());
+}
+
+bool GameState::ApplyInputPacket(Entity tank, Packet &packet) {
+    GameCommand::Type type;
+
+    if (!packet.ReadEnum(type)) {
+        return false;
+    }
+
+#define DO_COMMAND(type_id, command_type) \
+    case GameCommand::Type::type_id: { \
+        command_type command; \
+        if (!command.Deserialize(packet)) { \
+            return false; \
+        } \
+        return this->ApplyInput(tank, command); \
+    } break; \
+
+    switch (type) {
+        DO_COMMAND(MOVE_TANK,     MoveTankCommand)
+        DO_COMMAND(ROTATE_TURRET, RotateTurretCommand)
+        DO_COMMAND(CHARGE,        ChargeCommand)
+        DO_COMMAND(SWITCH_WEAPON, SwitchWeaponCommand)
         default:
             return false;
     }
 #undef DO_COMMAND
 }
 
+bool GameState::ApplyInput(Entity tank_entity, const GameCommand &command) {
+    // Same rules as the server command callbacks, but executed by everyone
+    if (!this->entities.IsValid(tank_entity) || this->entities.TryGet<CTank>(tank_entity) == nullptr) {
+        // Tank died before the input was applied
+        return true;
+    }
+
+    auto &tank = this->entities.Get<CTank>(tank_entity);
+
+    switch (command.type) {
+        case GameCommand::Type::MOVE_TANK: {
+            auto &move_tank = static_cast<const MoveTankCommand &>(command);
+            this->entities.Get<CPlanetPosition>(tank_entity).delta = move_tank.velocity;
+        } return true;
+
+        case GameCommand::Type::ROTATE_TURRET: {
+            auto &rotate_turret = static_cast<const RotateTurretCommand &>(command);
+
+            if (rotate_turret.is_absolute) {
+                tank.target_turret_rotation = rotate_turret.target_rotation;
+            } else {
+                tank.flags = rotate_turret.flags;
+            }
+        } return true;
+
+        case GameCommand::Type::CHARGE: {
+            auto &charge_command = static_cast<const ChargeCommand &>(command);
+            auto charging = this->entities.TryGet<CCharging>(tank_entity);
+
+            if (charge_command.fire) {
+                if (charging == nullptr) {
+                    return false;
+                }
+
+                if (tank.weapon_type != Weapon::Type::MACHINEGUN) {
+                    this->FireProjectile(tank_entity);
+                }
+
+                this->entities.Remove<CCharging>(tank_entity);
+            } else if (charging == nullptr) {
+                this->entities.Add<CCharging>(tank_entity).start_time = this->time;
+            } else {
+                charging->start_time = this->time;
+            }
+        } return true;
+
+        case GameCommand::Type::SWITCH_WEAPON: {
+            auto &switch_weapon = static_cast<const SwitchWeaponCommand &>(command);
+            tank.weapon_type = switch_weapon.weapon_type;
+        } return true;
+
+        default:
+            return false;
+    }
+}
+
+bool GameState::RunsGameplay() const {
+#if CLIENT
+    // Otherwise firing, hits and deaths come from the server
+    return this->settings.deterministic;
+#else
+    return true;
+#endif
+}
+
 void GameState::SerializeCommand(const GameCommand &command, Packet &packet) {
     packet.WriteEnum(command.type);
 
 #define DO_COMMAND(type_id, command_type) \
     case GameCommand::Type::type_id: { \
-        auto cmd = static_cast<const command_type &>(command); \
+        const auto &cmd = static_cast<const command_type &>(command); \
         cmd.Serialize(packet); \
     } break; \
 
@@ -168,27 +376,81 @@ void GameState::SerializeCommand(const GameCommand &command, Packet &packet) {
         DO_COMMAND(DESTROY_ENTITY,   DestroyEntityCommand)
         DO_COMMAND(SET_HEALTH,       SetHealthCommand)
         DO_COMMAND(PLAY_SFX,         PlaySfxCommand)
-        DO_COMMAND(SET_POSITION,     SetPositionCommand)
         DO_COMMAND(SWITCH_WEAPON,    SwitchWeaponCommand)
+        DO_COMMAND(DESTROY_ENTITIES, DestroyEntitiesCommand)
+        DO_COMMAND(FIRE_TRACERS,     FireTracersCommand)
     }
 #undef DO_COMMAND
 }
 
+// Sum over the planets gathered at the start of the tick
+Vec2 GameState::ComputePlanetForce(Vec2 position, f32 mass) const {
+    Vec2 force{};
+
+    for (const auto &planet : this->kinematic_sources) {
+        auto diff = planet.position - position;
+        if (diff != Vec2{}) {
+            force += GravityForce(diff, mass, planet.mass);
+        }
+    }
+
+    return force;
+}
+
 Vec2 GameState::GetTankWorldPosition(Entity entity) const {
+    if (auto transform = this->entities.TryGet<CWorldTransform>(entity); transform != nullptr && transform->planet != entt::null) {
+        return transform->position;
+    }
+
+    // Not ticked yet
+    const auto &tank = this->entities.Get<CTank>(entity);
+    return this->entities.Get<CPosition>(tank.planet_id).value + this->ComputeTankOffset(entity);
+}
+
+Vec2 GameState::ComputeTankOffset(Entity entity) const {
     const auto &tank = this->entities.Get<CTank>(entity);
     const auto &planet_position = this->entities.Get<CPlanetPosition>(entity);
     const auto &planet = this->entities.Get<CPlanet>(tank.planet_id);
-    const auto &planet_pos = this->entities.Get<CPosition>(tank.planet_id);
 
-    return planet_pos.value +
+    if (this->settings.deterministic) {
+        auto angle = glm::radians(planet_position.value);
+        return
+            (Vec2{planet.radius, planet.radius} +
+                Vec2{CTank::BASE_HEIGHT, CTank::BASE_HEIGHT} / 2.0f) *
+                Vec2{DeterministicCos(angle), DeterministicSin(angle)};
+    }
+
+    return
         (Vec2{planet.radius, planet.radius} +
             Vec2{CTank::BASE_HEIGHT, CTank::BASE_HEIGHT} / 2.0f) *
             Vec2{glm::cos(glm::radians(planet_position.value)),
                       glm::sin(glm::radians(planet_position.value))};
 }
 
-Array<Entity> GameState::Fire(Entity firing_tank, bool force) {
-    Array<Entity> res;
+void GameState::UpdateWorldTransforms() {
+    this->entities.View<CTank, CPlanetPosition>().each(
+        [&](Entity entity, CTank &tank, CPlanetPosition &planet_position) {
+            auto &transform = this->entities.impl.get_or_emplace<CWorldTransform>(entity);
+
+            // The planets move every tick, but cos/sin are only needed when the tank moved on its planet
+            if (transform.planet != tank.planet_id || transform.planet_position != planet_position.value) {
+                transform.planet = tank.planet_id;
+                transform.planet_position = planet_position.value;
+                transform.offset = this->ComputeTankOffset(entity);
+            }
+
+            transform.position = this->entities.Get<CPosition>(tank.planet_id).value + transform.offset;
+        });
+}
+
+const Array<Entity> &GameState::SpawnProjectiles(size_t count, const ProjectilePrototype &prototype, const CVelocity *velocities) {
+    this->spawned_projectiles.resize(count);
+    CreateProjectiles(this->entities, this->spawned_projectiles.data(), this->spawned_projectiles.data() + count, prototype, velocities);
+    return this->spawned_projectiles;
+}
+
+const Array<Entity> &GameState::Fire(Entity firing_tank, bool force) {
+    this->spawned_projectiles.clear();
 
     auto &tank = this->entities.Get<CTank>(firing_tank);
     auto &weapon = g_weapons[static_cast<size_t>(tank.weapon_type)];
@@ -199,12 +461,12 @@ Array<Entity> GameState::Fire(Entity firing_tank, bool force) {
         charge = std::min(this->time - charging->start_time, weapon.MAX_CHARGE);
     } else if (!force) {
         //log_debug("wtf", "not charging");
-        return res;
+        return this->spawned_projectiles;
     }
 
     if (tank.last_fire_time + weapon.cooldown > this->time && !force) {
         //log_debug("wtf", "cooldown {}"_format(this->time - tank.last_fire_time + weapon.cooldown));
-        return res;
+        return this->spawned_projectiles;
     }
 
     tank.last_fire_time = this->time;
@@ -212,27 +474,89 @@ Array<Entity> GameState::Fire(Entity firing_tank, bool force) {
     std::uniform_real_distribution dist_spread{-weapon.spread, weapon.spread};
     std::uniform_real_distribution dist_speed_spread{-weapon.speed_spread, weapon.speed_spread};
 
+    // Seeded per tank and tick, so the order in which tanks fire doesn't matter
+    DeterministicRng deterministic_rng{HashCombine(HashCombine(this->settings.seed, this->tick), entt::to_integral(firing_tank))};
+
+    this->fire_velocities.clear();
+
     for (size_t i = 0; i < weapon.burst; ++i) {
-        auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation + dist_spread(this->rng)));
+        Vec2 direction;
+        Vec2 velocity;
+
+        if (this->settings.deterministic) {
+            auto spread = deterministic_rng.Uniform(-weapon.spread, weapon.spread);
+            auto speed_spread = deterministic_rng.Uniform(-weapon.speed_spread, weapon.speed_spread);
+            direction = DeterministicRotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation + spread));
+            velocity = direction * (charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * (weapon.speed + speed_spread);
+        } else {
+            direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation + dist_spread(this->rng)));
+            velocity = direction * (charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * (weapon.speed + dist_speed_spread(this->rng));
+        }
+
+        this->fire_velocities.emplace_back(CVelocity{velocity});
+    }
 
-        auto projectile = CreateEntity(this->entities, EntityPrefabId::PROJECTILE);
-        auto velocity = direction * (charge / weapon.MAX_CHARGE + 0.3f) / 1.3f * (weapon.speed + dist_speed_spread(this->rng));
-        auto position = this->GetTankWorldPosition(firing_tank);
+    ProjectilePrototype prototype;
+    prototype.position = this->GetTankWorldPosition(firing_tank);
+    prototype.mass = weapon.projectile_mass;
+    prototype.ttl = weapon.projectile_ttl;
+    prototype.projectile.firing_entity = firing_tank;
+    prototype.projectile.impact_damage = weapon.damage;
 
-        this->entities.Get<CPosition>(projectile).value = position;
-        this->entities.Get<CVelocity>(projectile).value = velocity;
-        this->entities.Get<CMass>(projectile).value = weapon.projectile_mass;
-        this->entities.Get<CTimeToLiveBeforeExplosion>(projectile).value = weapon.projectile_ttl;
-        auto &projectile_component = this->entities.Get<CProjectile>(projectile);
-        projectile_component.firing_entity = firing_tank;
-        projectile_component.impact_damage = weapon.damage;
+    const auto &projectiles = this->SpawnProjectiles(this->fire_velocities.size(), prototype, this->fire_velocities.data());
 
-        res.emplace_back(projectile);
+    if (this->settings.deterministic) {
+        for (size_t i = 0; i < projectiles.size(); ++i) {
+            this->entities.Add<CFixedBody>(projectiles[i], FixedVec2::FromVec2(prototype.position), FixedVec2::FromVec2(this->fire_velocities[i].value));
+        }
     }
 
     //log_debug("wtf", "fire");
 
-    return res;
+    return projectiles;
+}
+
+// Queues the rounds for the collision system, no entities are created
+bool GameState::FireHitscan(Entity firing_tank, u32 rewind_ticks) {
+    auto &tank = this->entities.Get<CTank>(firing_tank);
+    auto &weapon = g_weapons[static_cast<size_t>(tank.weapon_type)];
+
+    if (tank.last_fire_time + weapon.cooldown > this->time) {
+        return false;
+    }
+
+    tank.last_fire_time = this->time;
+
+    std::uniform_real_distribution dist_spread{-weapon.spread, weapon.spread};
+    auto from = this->GetTankWorldPosition(firing_tank);
+
+    for (size_t i = 0; i < weapon.burst; ++i) {
+        auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(tank.turret_rotation + dist_spread(this->rng)));
+        this->hitscan_shots.emplace_back(HitscanShot{firing_tank, from, from + direction * Weapon::HITSCAN_RANGE, weapon.damage, rewind_ticks});
+    }
+
+    return true;
+}
+
+void GameState::DestroyEntity(Entity entity) {
+    // Deferred, the systems call this from inside of entt iterations
+    this->commands.Destroy(entity);
+}
+
+void GameState::FlushCommands() {
+    if (this->commands.IsEmpty()) {
+        return;
+    }
+
+    this->OnDestroyEntities(this->commands.destroyed);
+
+    for (auto entity : this->commands.destroyed) {
+        if (this->entities.IsValid(entity)) {
+            this->entities.Destroy(entity);
+        }
+    }
+
+    this->commands.Clear();
 }
 
 Vec2 GameState::GetSunPosition() const {
@@ -240,9 +564,59 @@ Vec2 GameState::GetSunPosition() const {
 }
 
 void GameState::Clone(GameState &target) const {
-    this->entities.Each([&](Entity entity) { target.entities.Create(entity); });
     CloneRegistry(this->entities, target.entities);
+    target.settings = this->settings;
     target.background_color = this->background_color;
     target.size = this->size;
+    target.gravity_field = this->gravity_field;
+    target.rng = this->rng;
     target.time = this->time;
+    target.tick = this->tick;
+}
+
+void GameState::CaptureSnapshot(GameStateSnapshot &snapshot) const {
+    snapshot.entities.Capture(this->entities);
+    snapshot.gravity_field = this->gravity_field;
+    snapshot.rng = this->rng;
+    snapshot.time = this->time;
+    snapshot.tick = this->tick;
+}
+
+void GameState::RestoreSnapshot(const GameStateSnapshot &snapshot) {
+    snapshot.entities.Restore(this->entities);
+    this->gravity_field = snapshot.gravity_field;
+    this->rng = snapshot.rng;
+    this->time = snapshot.time;
+    this->tick = snapshot.tick;
+    this->commands.Clear();
+}
+
+void GameState::UpdateBroadphase() {
+    this->broadphase.Clear();
+
+    this->entities.View<CTank, CHealth>().each(
+        [&](Entity entity, CTank &tank, CHealth &health) {
+            this->broadphase.Insert(entity, this->GetTankWorldPosition(entity), 0.0f, GameState::COLLIDER_TANK);
+        });
+
+    this->entities.View<CPlanet, CPosition>().each(
+        [&](Entity entity, CPlanet &planet, CPosition &position) {
+            this->broadphase.Insert(entity, position.value, planet.radius, GameState::COLLIDER_PLANET);
+        });
+
+    this->broadphase.Build();
+}
+
+void GameState::QueryRadius(Vec2 center, f32 radius, u32 mask, Array<Entity> &output) const {
+    this->broadphase.ForEachInRadius(center, radius, mask,
+        [&](const SpatialHash::Entry &entry) {
+            output.emplace_back(entry.entity);
+        });
+}
+
+void GameState::QueryRect(Vec2 min, Vec2 max, u32 mask, Array<Entity> &output) const {
+    this->broadphase.ForEachInRect(min, max, mask,
+        [&](const SpatialHash::Entry &entry) {
+            output.emplace_back(entry.entity);
+        });
 }
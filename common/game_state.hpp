@@ -3,8 +3,16 @@
 #include "common/packet.hpp"
 #include "common/entity.hpp"
 #include "common/crc32.hpp"
+#include "common/gravity.hpp"
+#include "common/body_arrays.hpp"
+#include "common/spatial_hash.hpp"
+#include "common/system_scheduler.hpp"
+#include "common/command_buffer.hpp"
+#include "common/registry_snapshot.hpp"
+#include "common/transform_history.hpp"
 
 struct ClientConnection;
+struct WorkerPool;
 
 struct GameCommand {
 public:
@@ -16,8 +24,9 @@ public:
         DESTROY_ENTITY   = 5,
         SET_HEALTH       = 6,
         PLAY_SFX         = 7,
-        SET_POSITION     = 8,
         SWITCH_WEAPON    = 9,
+        DESTROY_ENTITIES = 10,
+        FIRE_TRACERS     = 11,
     };
 
     Type type;
@@ -80,6 +89,36 @@ struct DestroyEntityCommand : public GameCommand {
     EntityId target = 0;
 };
 
+// Everything destroyed in one tick
+struct DestroyEntitiesCommand : public GameCommand {
+    constexpr static u32 MAX_TARGETS = 4096;
+
+    inline DestroyEntitiesCommand() : GameCommand(GameCommand::Type::DESTROY_ENTITIES) {}
+
+    void Serialize(Packet &packet) const;
+    bool Deserialize(Packet &packet);
+
+    Array<EntityId> targets;
+};
+
+// Every hitscan round of one tick, only for the looks. The server already applied the hits.
+struct FireTracersCommand : public GameCommand {
+    constexpr static u32 MAX_TRACERS = 4096;
+
+    struct Tracer {
+        EntityId firing_entity = 0;
+        Vec2 from{};
+        Vec2 to{}; // Where the round stopped
+    };
+
+    inline FireTracersCommand() : GameCommand(GameCommand::Type::FIRE_TRACERS) {}
+
+    void Serialize(Packet &packet) const;
+    bool Deserialize(Packet &packet);
+
+    Array<Tracer> tracers;
+};
+
 struct SetHealthCommand : public GameCommand {
     inline SetHealthCommand() : GameCommand(GameCommand::Type::SET_HEALTH) {}
 
@@ -106,43 +145,177 @@ struct PlaySfxCommand : public GameCommand {
     Sfx sfx = Sfx::NONE;
 };
 
-struct SetPositionCommand : public GameCommand {
-    inline SetPositionCommand() : GameCommand(GameCommand::Type::SET_POSITION) {}
+struct SwitchWeaponCommand : public GameCommand {
+    inline SwitchWeaponCommand() : GameCommand(GameCommand::Type::SWITCH_WEAPON) {}
 
     void Serialize(Packet &packet) const;
     bool Deserialize(Packet &packet);
 
-    EntityId target = 0;
-    Vec2 position{};
+    Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
 };
 
-struct SwitchWeaponCommand : public GameCommand {
-    inline SwitchWeaponCommand() : GameCommand(GameCommand::Type::SWITCH_WEAPON) {}
+// How the dynamic bodies are advanced, see SimSettings::integrator
+enum class Integrator : u8 {
+    EULER    = 0, // Full drift, then the kick
+    LEAPFROG = 1, // Drift-kick-drift, symplectic and second order, stays stable at larger ticks
+    COUNT
+};
 
+inline StringView ToString(Integrator integrator) {
+    switch (integrator) {
+        case Integrator::EULER:
+            return "euler";
+        case Integrator::LEAPFROG:
+            return "leapfrog";
+        default:
+            return "(unknown)";
+    }
+}
+
+// Per session simulation options, the server sends these to the clients with the level
+struct SimSettings {
     void Serialize(Packet &packet) const;
     bool Deserialize(Packet &packet);
 
-    Weapon::Type weapon_type = Weapon::Type::MACHINEGUN;
+    GravitySolver gravity_solver = GravitySolver::EXACT;
+    f32 barnes_hut_theta = 0.5f;
+    f32 field_max_error = 0.001f; // Acceleration per unit mass and tick
+    bool simd_kernel = false; // Integrate and do exact gravity on the BodyArrays mirror instead of the registry
+    bool strict_kernel = true; // Bit-identical to the registry loop
+    bool deterministic = false; // Lockstep: fixed point physics, clients simulate from the input stream
+    u64 seed = 0;
+    u32 input_delay_ticks = 6;
+    Integrator integrator = Integrator::EULER; // The deterministic mode always uses Euler
+    u32 max_substeps = 4; // Leapfrog splits the tick into this many substeps for projectiles close to a planet
+    f32 substep_radius = 3.0f; // In planet radii
+    u32 tick_interval = 1; // Server frames per simulation tick, 2 and 3 run the session at 30 and 20 Hz
+    u32 max_rewind_ticks = 20; // Lag compensation window, 0 turns it off. Never used in the deterministic mode.
+    bool hitscan_machinegun = false; // Trace machinegun rounds instead of spawning projectiles. Never used in the deterministic mode.
+
+    constexpr static u32 MAX_SUBSTEPS = 32;
+    constexpr static u32 MAX_TICK_INTERVAL = 6;
+    constexpr static u32 MAX_REWIND_TICKS = 120;
+};
+
+// World state for forking the simulation (prediction, rollback, save states). The settings and the level size
+// don't change during a session, the queued lockstep inputs stay with the caller.
+struct GameStateSnapshot {
+    RegistrySnapshot entities;
+    GravityField gravity_field; // Only rebuilt once the planets moved far enough, so the grid is state as well
+    std::mt19937 rng; // Weapon spread outside of the deterministic mode
+    f32 time = 0.0f;
+    u32 tick = 0;
 };
 
 struct GameState {
     struct CommandContext {
         ClientConnection *con = nullptr;
+        Entity tank = entt::null; // Issuing tank of a command without connection, e.g. from an NPC
+    };
+
+    constexpr static u32 COLLIDER_TANK   = 1 << 0;
+    constexpr static u32 COLLIDER_PLANET = 1 << 1;
+
+    // A projectile close to a planet, state at the start of the tick so the leapfrog can redo it in substeps
+    struct SubstepBody {
+        Entity entity;
+        Vec2 position;
+        Vec2 velocity;
+    };
+
+    // First thing a projectile touched on its path this tick, null if nothing
+    struct ProjectileHit {
+        Entity projectile;
+        Entity target = entt::null;
+        bool is_tank = false;
+    };
+
+    // A machinegun round, traced in the collision system together with the projectile paths
+    struct HitscanShot {
+        Entity firing_entity;
+        Vec2 from;
+        Vec2 to; // End of the range, the first contact once it is resolved
+        f32 damage;
+        u32 rewind_ticks = 0;
+        Entity target = entt::null;
+        bool is_tank = false;
+    };
+
+    // Player input in the deterministic mode, applied on all machines at the start of the given tick
+    struct PendingInput {
+        u32 tick;
+        Entity tank;
+        Array<char> command; // Packet buffer including the (unused) header
     };
 
+    GameState();
     void Tick(f32 dt);
+    void TickApplyInputs(f32 dt);
+    void TickMachinegun(f32 dt);
+    void TickIntegrate(f32 dt);
+    void TickMoveTanks(f32 dt);
+    void TickTurretRotation(f32 dt);
+    void TickGravity(f32 dt);
+    void TickFinishIntegrate(f32 dt);
+    void TickPlanetOrbit(f32 dt);
+    void TickWorldTransforms(f32 dt);
+    void TickRecordHistory(f32 dt);
+    void TickBroadphase(f32 dt);
+    void TickCollision(f32 dt);
+    void TickTimeToLive(f32 dt);
+    void TickDeadEntities(f32 dt);
+    void TickFlushCommands(f32 dt);
     void SerializeCommand(const GameCommand &command, Packet &packet);
     bool HandleCommandPacket(const CommandContext &context, Packet &packet);
     virtual bool HandleCommand(const CommandContext &context, GameCommand &command) = 0;
+    void QueueInput(u32 tick, Entity tank, Array<char> &&command);
+    void ApplyPendingInputs();
+    bool ApplyInputPacket(Entity tank, Packet &packet);
+    bool ApplyInput(Entity tank_entity, const GameCommand &command);
+    bool RunsGameplay() const;
+    Vec2 ComputePlanetForce(Vec2 position, f32 mass) const;
     Vec2 GetTankWorldPosition(Entity entity) const;
-    Array<Entity> Fire(Entity firing_tank, bool force);
+    Vec2 ComputeTankOffset(Entity entity) const;
+    void UpdateWorldTransforms();
+    const Array<Entity> &SpawnProjectiles(size_t count, const ProjectilePrototype &prototype, const CVelocity *velocities);
+    const Array<Entity> &Fire(Entity firing_tank, bool force); // Valid until the next Fire or SpawnProjectiles
+    bool FireHitscan(Entity firing_tank, u32 rewind_ticks);
     Vec2 GetSunPosition() const;
-    virtual void DestroyEntity(Entity entity) = 0;
+    void DestroyEntity(Entity entity);
+    void FlushCommands();
+    virtual void OnDestroyEntities(const Array<Entity> &destroyed) = 0; // Called before they are destroyed
+    virtual bool FireProjectile(Entity firing_tank) = 0;
     void Clone(GameState &target) const;
+    void CaptureSnapshot(GameStateSnapshot &snapshot) const;
+    void RestoreSnapshot(const GameStateSnapshot &snapshot);
+    void UpdateBroadphase();
+    void QueryRadius(Vec2 center, f32 radius, u32 mask, Array<Entity> &output) const;
+    void QueryRect(Vec2 min, Vec2 max, u32 mask, Array<Entity> &output) const;
 
     EntityRegistry entities;
+    SimSettings settings;
+    SystemScheduler scheduler;
+    CommandBuffer commands;
+    WorkerPool *worker_pool = nullptr; // Systems of one stage run in parallel on it, sequential if null
+    GravityQuadTree gravity_tree;
+    GravityField gravity_field;
+    Array<GravitySource> gravity_sources;
+    BodyArrays body_arrays;
+    Array<SubstepBody> substep_bodies;
+    Array<GravitySource> kinematic_sources; // Planets, gathered at the start of the tick
+    Array<f32> kinematic_radii; // Radius of kinematic_sources[i]
+    Array<FixedGravitySource> fixed_gravity_sources;
+    Array<ProjectileHit> projectile_hits;
+    Array<HitscanShot> hitscan_shots; // Of this tick
+    Array<Entity> damaged_tanks; // Of this tick
+    SpatialHash broadphase;
+    TransformHistory tank_history;
     Color background_color;
     Vec2 size;
     f32 time = 0.0f;
+    u32 tick = 0;
+    Array<PendingInput> pending_inputs;
+    Array<Entity> spawned_projectiles;
+    Array<CVelocity> fire_velocities;
     std::mt19937 rng{std::random_device{}()};
 };
@@ -0,0 +1,244 @@
+#include "common/gravity.hpp"
+
+#include <algorithm>
+
+static void BuildNode(GravityQuadTree &tree, i32 node_index, i32 depth) {
+    auto &node = tree.nodes[node_index];
+    auto begin = tree.sources.begin() + node.first_source;
+    auto end = begin + node.num_sources;
+
+    Vec2 weighted_position{};
+    f32 mass = 0.0f;
+
+    for (auto it = begin; it != end; ++it) {
+        weighted_position += it->position * it->mass;
+        mass += it->mass;
+    }
+
+    node.mass = mass;
+    node.center_of_mass = mass > 0.0f ? weighted_position / mass : node.min + node.size / 2.0f;
+
+    if (node.num_sources <= GravityQuadTree::leaf_capacity || depth >= GravityQuadTree::max_depth) {
+        return;
+    }
+
+    auto half = node.size / 2.0f;
+    auto center = node.min + half;
+
+    // Partition into the quadrants: bottom-left, bottom-right, top-left, top-right
+    auto split_y = std::partition(begin, end, [&](const GravitySource &source) { return source.position.y < center.y; });
+    auto split_x_bottom = std::partition(begin, split_y, [&](const GravitySource &source) { return source.position.x < center.x; });
+    auto split_x_top = std::partition(split_y, end, [&](const GravitySource &source) { return source.position.x < center.x; });
+
+    std::array<std::pair<decltype(begin), decltype(begin)>, 4> ranges{{
+        {begin, split_x_bottom},
+        {split_x_bottom, split_y},
+        {split_y, split_x_top},
+        {split_x_top, end},
+    }};
+
+    std::array<Vec2, 4> mins{
+        node.min,
+        Vec2{center.x, node.min.y},
+        Vec2{node.min.x, center.y},
+        center,
+    };
+
+    auto first_child = static_cast<i32>(tree.nodes.size());
+    tree.nodes[node_index].first_child = first_child;
+
+    for (size_t i = 0; i < 4; ++i) {
+        GravityQuadTree::Node child;
+        child.min = mins[i];
+        child.size = half;
+        child.first_source = static_cast<i32>(ranges[i].first - tree.sources.begin());
+        child.num_sources = static_cast<i32>(ranges[i].second - ranges[i].first);
+        tree.nodes.emplace_back(child);
+    }
+
+    // NOTE: Don't hold on to node references here, the vector might have grown
+    for (i32 i = 0; i < 4; ++i) {
+        BuildNode(tree, first_child + i, depth + 1);
+    }
+}
+
+void GravityQuadTree::Build(const Array<GravitySource> &sources) {
+    this->nodes.clear();
+    this->sources = sources;
+
+    if (this->sources.empty()) {
+        return;
+    }
+
+    Vec2 min = this->sources[0].position;
+    Vec2 max = min;
+
+    for (const auto &source : this->sources) {
+        min = glm::min(min, source.position);
+        max = glm::max(max, source.position);
+    }
+
+    Node root;
+    root.min = min;
+    // Slightly enlarge the square so that the points on the max edge fall into a quadrant too
+    root.size = std::max(max.x - min.x, max.y - min.y) * 1.001f + 1.0f;
+    root.first_source = 0;
+    root.num_sources = static_cast<i32>(this->sources.size());
+    this->nodes.emplace_back(root);
+
+    BuildNode(*this, 0, 0);
+}
+
+Vec2 GravityQuadTree::ComputeForce(Vec2 position, f32 mass, Entity self, f32 theta) const {
+    Vec2 force{};
+
+    if (this->nodes.empty()) {
+        return force;
+    }
+
+    std::array<i32, 4 * GravityQuadTree::max_depth + 4> stack;
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        const auto &node = this->nodes[stack[--stack_size]];
+
+        if (node.num_sources == 0) {
+            continue;
+        }
+
+        if (node.first_child == -1) {
+            for (i32 i = node.first_source; i < node.first_source + node.num_sources; ++i) {
+                const auto &source = this->sources[i];
+
+                if (source.entity == self) {
+                    continue;
+                }
+
+                force += GravityForce(source.position - position, mass, source.mass);
+            }
+
+            continue;
+        }
+
+        // A node that contains the sample position also contains the sample itself, so it always needs to be opened
+        auto contains_position =
+            position.x >= node.min.x && position.x < node.min.x + node.size &&
+            position.y >= node.min.y && position.y < node.min.y + node.size;
+
+        auto diff = node.center_of_mass - position;
+        auto dist = glm::length(diff);
+
+        if (!contains_position && node.size < theta * dist) {
+            force += GravityForce(diff, mass, node.mass);
+        } else {
+            for (i32 i = 0; i < 4; ++i) {
+                stack[stack_size++] = node.first_child + i;
+            }
+        }
+    }
+
+    return force;
+}
+
+void GravityField::Update(const Array<GravitySource> &planets, Vec2 world_size, f32 max_error) {
+    this->planets = planets;
+
+    auto same_planets =
+        this->num_builds > 0 &&
+        this->world_size == world_size &&
+        this->built_planets.size() == planets.size() &&
+        std::equal(planets.begin(), planets.end(), this->built_planets.begin(),
+            [](const GravitySource &a, const GravitySource &b) {
+                return a.entity == b.entity && a.mass == b.mass;
+            });
+
+    if (same_planets) {
+        // The force is linear in each planet's position, so a planet that moved by d changes the acceleration by at most G * m * d
+        this->staleness_error = 0.0f;
+
+        for (size_t i = 0; i < planets.size(); ++i) {
+            this->staleness_error += gravitational_constant * planets[i].mass * glm::length(planets[i].position - this->built_planets[i].position);
+        }
+
+        if (this->GetErrorBound() <= max_error) {
+            return;
+        }
+    }
+
+    this->Build(world_size, max_error);
+}
+
+void GravityField::Build(Vec2 world_size, f32 max_error) {
+    this->built_planets = this->planets;
+    this->world_size = world_size;
+    this->staleness_error = 0.0f;
+    ++this->num_builds;
+
+    while (true) {
+        this->num_nodes = Vec2i{glm::ceil(world_size / this->cell_size)} + 1;
+        this->nodes.resize(static_cast<size_t>(this->num_nodes.x) * this->num_nodes.y);
+
+        for (i32 y = 0; y < this->num_nodes.y; ++y) {
+            for (i32 x = 0; x < this->num_nodes.x; ++x) {
+                this->nodes[y * this->num_nodes.x + x] = this->ComputeExactAcceleration(Vec2{x, y} * this->cell_size);
+            }
+        }
+
+        // The interpolation is worst in the cell centers, measure it there. Half of the budget is for the interpolation,
+        // the other half for the planets moving away from where the grid was built.
+        this->interpolation_error = 0.0f;
+
+        for (i32 y = 0; y + 1 < this->num_nodes.y; ++y) {
+            for (i32 x = 0; x + 1 < this->num_nodes.x; ++x) {
+                auto center = (Vec2{x, y} + 0.5f) * this->cell_size;
+                auto error = glm::length(this->SampleAcceleration(center) - this->ComputeExactAcceleration(center));
+                this->interpolation_error = std::max(this->interpolation_error, error);
+            }
+        }
+
+        if (this->interpolation_error <= max_error / 2.0f || this->cell_size <= min_cell_size) {
+            return;
+        }
+
+        this->cell_size = std::max(min_cell_size, this->cell_size / 2.0f);
+    }
+}
+
+Vec2 GravityField::ComputeExactAcceleration(Vec2 position) const {
+    Vec2 acceleration{};
+
+    for (const auto &planet : this->built_planets) {
+        auto diff = planet.position - position;
+        if (diff != Vec2{}) {
+            acceleration += GravityForce(diff, 1.0f, planet.mass);
+        }
+    }
+
+    return acceleration;
+}
+
+Vec2 GravityField::SampleAcceleration(Vec2 position) const {
+    auto grid_position = position / this->cell_size;
+    auto cell = Vec2i{glm::floor(grid_position)};
+
+    if (cell.x < 0 || cell.y < 0 || cell.x + 1 >= this->num_nodes.x || cell.y + 1 >= this->num_nodes.y) {
+        // Outside of the grid, sum over the current planet positions
+        Vec2 acceleration{};
+
+        for (const auto &planet : this->planets) {
+            auto diff = planet.position - position;
+            if (diff != Vec2{}) {
+                acceleration += GravityForce(diff, 1.0f, planet.mass);
+            }
+        }
+
+        return acceleration;
+    }
+
+    auto t = grid_position - Vec2{cell};
+    auto index = cell.y * this->num_nodes.x + cell.x;
+    auto bottom = glm::mix(this->nodes[index], this->nodes[index + 1], t.x);
+    auto top = glm::mix(this->nodes[index + this->num_nodes.x], this->nodes[index + this->num_nodes.x + 1], t.x);
+    return glm::mix(bottom, top, t.y);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+enum class GravitySolver : u8 {
+    EXACT      = 0, // Pairwise O(n^2), this is the reference
+    BARNES_HUT = 1, // Quadtree O(n log n)
+    FIELD      = 2, // Planet field sampled on a grid, projectiles are test masses, O(1) per projectile
+    COUNT
+};
+
+inline StringView ToString(GravitySolver solver) {
+    switch (solver) {
+        case GravitySolver::EXACT:
+            return "exact";
+        case GravitySolver::BARNES_HUT:
+            return "barnes-hut";
+        case GravitySolver::FIELD:
+            return "field";
+        default:
+            return "(unknown)";
+    }
+}
+
+constexpr f32 gravitational_constant = 0.0000001f;
+
+// Every solver has to go through this so the results stay comparable to the exact loop.
+inline Vec2 GravityForce(Vec2 diff, f32 mass, f32 other_mass) {
+    auto dist = glm::length(diff);
+    return gravitational_constant * diff * mass * other_mass / dist * dist;
+}
+
+// Deterministic mode, the constant is exactly 1 / 10000000 so it becomes an integer division
+constexpr i64 gravitational_divisor = 10000000;
+
+inline FixedVec2 FixedGravityForce(FixedVec2 diff, Fixed mass, Fixed other_mass) {
+    return diff * mass * other_mass / gravitational_divisor;
+}
+
+struct GravitySource {
+    Vec2 position;
+    f32 mass;
+    Entity entity;
+};
+
+struct FixedGravitySource {
+    FixedVec2 position;
+    Fixed mass;
+    Entity entity;
+};
+
+struct GravityQuadTree {
+    constexpr static i32 leaf_capacity = 8;
+    constexpr static i32 max_depth = 16;
+
+    struct Node {
+        Vec2 min;
+        f32 size = 0.0f;
+        Vec2 center_of_mass{};
+        f32 mass = 0.0f;
+        i32 first_child = -1; // The four children are stored next to each other, -1 for leafs
+        i32 first_source = 0;
+        i32 num_sources = 0;
+    };
+
+    void Build(const Array<GravitySource> &sources);
+    Vec2 ComputeForce(Vec2 position, f32 mass, Entity self, f32 theta) const;
+
+    Array<Node> nodes;
+    Array<GravitySource> sources; // Reordered so that every node covers a contiguous range
+};
+
+// Gravity of the planets (per unit mass) sampled on a grid and bilinearly interpolated. Projectiles only
+// feel the planets here, their attraction to each other is dropped.
+// Rebuilt lazily: the error against the exact planet sum is the measured interpolation error plus a bound
+// for how far the planets moved since the build, the grid is rebuilt (and refined) when that exceeds max_error.
+struct GravityField {
+    constexpr static f32 min_cell_size = 8.0f;
+
+    void Update(const Array<GravitySource> &planets, Vec2 world_size, f32 max_error);
+    void Build(Vec2 world_size, f32 max_error);
+    Vec2 ComputeExactAcceleration(Vec2 position) const;
+    Vec2 SampleAcceleration(Vec2 position) const;
+
+    inline Vec2 ComputeForce(Vec2 position, f32 mass) const {
+        return this->SampleAcceleration(position) * mass;
+    }
+
+    // Maximum acceleration error against the exact sum over the planets, inside of the grid
+    inline f32 GetErrorBound() const {
+        return this->interpolation_error + this->staleness_error;
+    }
+
+    Array<GravitySource> planets; // Current positions, used outside of the grid
+    Array<GravitySource> built_planets; // Positions the grid was built with
+    Array<Vec2> nodes;
+    Vec2i num_nodes{};
+    Vec2 world_size{};
+    f32 cell_size = 64.0f;
+    f32 interpolation_error = 0.0f;
+    f32 staleness_error = 0.0f;
+    u32 num_builds = 0;
+};
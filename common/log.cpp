@@ -1,6 +1,7 @@
 #include "log.hpp"
 
 #include <chrono>
+#include <mutex>
 
 #ifdef CLIENT
 #include "client/client.hpp"
@@ -19,6 +20,10 @@ static void DoLog(
     fmt::text_style tag_style,
     fmt::text_style message_style = {},
     Color color = {}) {
+    // The server logs from its worker threads too
+    static std::mutex mutex;
+    std::lock_guard lock{mutex};
+
     auto time = chrono::system_clock::to_time_t(chrono::system_clock::now());
     auto time_string = fmt::format(
         "{:%H:%M:%S}.{:#03}",
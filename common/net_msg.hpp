@@ -5,6 +5,7 @@
 #include "common/packet.hpp"
 #include "common/player_info.hpp"
 #include "common/disconnect_reason.hpp"
+#include "common/tick_stats.hpp"
 
 #include <variant>
 
@@ -25,6 +26,11 @@ enum class NetMessageType : u8 {
     PAUSE_GAME           = 14,
     LOBBY_UPDATE         = 15,
     DISCONNECT           = 16,
+    INPUT_COMMAND        = 17,
+    TICK_STATS           = 18,
+    ENTITY_SNAPSHOT      = 19,
+    SNAPSHOT_ACK         = 20,
+    INPUTS_CONFIRMED     = 21,
     COUNT
 };
 
@@ -318,6 +324,156 @@ struct GameCommandMessage : public NetMessage<NetMessageType::GAME_COMMAND> {
     }
 };
 
+// Deterministic mode: a player input, to be applied at the start of the given tick
+struct InputCommandMessage : public NetMessage<NetMessageType::INPUT_COMMAND> {
+    constexpr static u32 MAX_COMMAND_SIZE = 256;
+
+    u32 tick = 0;
+    u32 tank = 0;
+    Array<char> command; // Serialized GameCommand
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU32(this->tick);
+        packet.WriteU32(this->tank);
+        packet.WriteU32(static_cast<u32>(this->command.size()));
+        packet.WriteData(this->command.data(), static_cast<u32>(this->command.size()));
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        u32 size = 0;
+
+        if (!packet.ReadU32(this->tick) || !packet.ReadU32(this->tank) || !packet.ReadU32(size) || size > MAX_COMMAND_SIZE) {
+            return false;
+        }
+
+        this->command.resize(size);
+        return packet.ReadData(this->command.data(), size);
+    }
+};
+
+// Deterministic mode: every INPUT_COMMAND for the ticks before this one has been sent, so clients can simulate them
+struct InputsConfirmedMessage : public NetMessage<NetMessageType::INPUTS_CONFIRMED> {
+    u32 tick = 0;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU32(this->tick);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadU32(this->tick);
+    }
+};
+
+// Followed by the delta against the baseline, see WriteSnapshotDelta
+struct EntitySnapshotMessage : public NetMessage<NetMessageType::ENTITY_SNAPSHOT> {
+    u32 id = 0;
+    u32 baseline = 0; // 0 if the delta contains everything
+    u32 tick = 0;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU32(this->id);
+        packet.WriteU32(this->baseline);
+        packet.WriteU32(this->tick);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadU32(this->id) &&
+            packet.ReadU32(this->baseline) &&
+            packet.ReadU32(this->tick);
+    }
+};
+
+// The client applied this snapshot, the next deltas can be against it
+struct SnapshotAckMessage : public NetMessage<NetMessageType::SNAPSHOT_ACK> {
+    u32 id = 0;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU32(this->id);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return
+            packet.ReadU32(this->id);
+    }
+};
+
+struct TickStatsRequest : public NetMessage<NetMessageType::TICK_STATS> {
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        return true;
+    }
+};
+
+// Tick timings of the server loop followed by the ones of every running session
+struct TickStatsResponse : public NetMessage<NetMessageType::TICK_STATS> {
+    Array<TickStats::Summary> summaries;
+
+    inline void Serialize(Packet &packet) const {
+        NetMessage::Serialize(packet);
+
+        packet.WriteU16(this->summaries.size());
+
+        for (const auto &summary : this->summaries) {
+            packet.WriteString(summary.name);
+            packet.WriteU32(summary.num_ticks);
+            packet.WriteU32(summary.num_overruns);
+            packet.WriteU16(summary.phases.size());
+
+            for (const auto &phase : summary.phases) {
+                packet.WriteString(phase.name);
+                packet.WriteF32(phase.p50_ms);
+                packet.WriteF32(phase.p99_ms);
+                packet.WriteF32(phase.max_ms);
+            }
+        }
+    }
+
+    inline bool Deserialize(Packet &packet) {
+        u16 num_summaries;
+        if (!packet.ReadU16(num_summaries)) {
+            return false;
+        }
+
+        this->summaries.resize(num_summaries);
+
+        for (auto &summary : this->summaries) {
+            u16 num_phases;
+            if (!packet.ReadString(summary.name) ||
+                !packet.ReadU32(summary.num_ticks) ||
+                !packet.ReadU32(summary.num_overruns) ||
+                !packet.ReadU16(num_phases)) {
+                return false;
+            }
+
+            summary.phases.resize(num_phases);
+
+            for (auto &phase : summary.phases) {
+                if (!packet.ReadString(phase.name) ||
+                    !packet.ReadF32(phase.p50_ms) ||
+                    !packet.ReadF32(phase.p99_ms) ||
+                    !packet.ReadF32(phase.max_ms)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+};
+
 struct ShutdownMessage : public NetMessage<NetMessageType::SHUTDOWN> {
     inline void Serialize(Packet &packet) const {
         NetMessage::Serialize(packet);
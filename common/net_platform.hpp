@@ -9,6 +9,8 @@
 #	include <arpa/inet.h>
 #	include <errno.h>
 #	include <poll.h>
+#	include <sys/epoll.h>
+#	include <sys/uio.h>
 #   include <string.h>
 #   include <assert.h>
 
@@ -58,6 +60,20 @@ inline int Poll(pollfd *fds, int n, int timeout) {
     return ::poll(fds, n, timeout);
 }
 
+using IoVec = iovec;
+
+inline IoVec MakeIoVec(const void *data, size_t size) {
+    return iovec{const_cast<void *>(data), size};
+}
+
+// Bytes sent or -1, like send()
+inline ssize_t SendVectored(SocketDescriptor sd, IoVec *vecs, int count) {
+    msghdr msg{};
+    msg.msg_iov = vecs;
+    msg.msg_iovlen = count;
+    return sendmsg(sd, &msg, 0);
+}
+
 }
 
 #else
@@ -145,5 +161,22 @@ inline int Poll(pollfd *fds, int n, int timeout) {
     return WSAPoll(fds, n, timeout);
 }
 
+using IoVec = WSABUF;
+
+inline IoVec MakeIoVec(const void *data, size_t size) {
+    return WSABUF{static_cast<ULONG>(size), static_cast<CHAR *>(const_cast<void *>(data))};
+}
+
+// Bytes sent or -1, like send()
+inline long long SendVectored(SocketDescriptor sd, IoVec *vecs, int count) {
+    DWORD sent = 0;
+
+    if (WSASend(sd, vecs, count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+        return -1;
+    }
+
+    return sent;
+}
+
 }
 #endif
@@ -3,6 +3,10 @@
 #include "common.hpp"
 
 struct Packet_Header {
+    // The packet is a frame of several messages. Each of them follows a u16 length instead of its own header.
+    constexpr static u32 FRAME_FLAG = 1u << 31;
+    constexpr static size_t MAX_FRAMED_MESSAGE_SIZE = 0xffff;
+
     u32 size;
 };
 
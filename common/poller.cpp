@@ -0,0 +1,140 @@
+#include "common/poller.hpp"
+
+#include "common/log.hpp"
+
+namespace net {
+
+Poller::~Poller() {
+    this->Stop();
+}
+
+bool Poller::Start(PollerBackend backend) {
+    this->Stop();
+    this->backend = PollerBackend::POLL;
+
+#ifdef LINUX
+    if (backend == PollerBackend::EPOLL || backend == PollerBackend::IO_URING) {
+        this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (this->epoll_fd == -1) {
+            LogWarning("poller", "epoll is not available, falling back to poll: {}"_format(GetErrorString()));
+        } else {
+            this->backend = PollerBackend::EPOLL;
+            this->epoll_events.resize(1024);
+        }
+    }
+#endif
+
+    return this->backend == backend;
+}
+
+void Poller::Stop() {
+#ifdef LINUX
+    if (this->epoll_fd != -1) {
+        close(this->epoll_fd);
+        this->epoll_fd = -1;
+    }
+#endif
+
+    this->pollfds.clear();
+}
+
+void Poller::Add(SocketDescriptor sd, i32 id) {
+#ifdef LINUX
+    if (this->backend == PollerBackend::EPOLL) {
+        struct epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = static_cast<u64>(id);
+
+        if (epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, sd, &event) == -1) {
+            LogError("poller", "Cannot add socket {}: {}"_format(id, GetErrorString()));
+        }
+
+        return;
+    }
+#endif
+
+    if (static_cast<size_t>(id) >= this->pollfds.size()) {
+        this->pollfds.resize(id + 1, pollfd{.fd = -1, .events = 0, .revents = 0});
+    }
+
+    // A new socket is writable, only reading needs an event
+    this->pollfds[id] = pollfd{.fd = sd, .events = POLLIN, .revents = 0};
+}
+
+void Poller::Remove(SocketDescriptor sd, i32 id) {
+#ifdef LINUX
+    if (this->backend == PollerBackend::EPOLL) {
+        if (sd != -1) {
+            epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, sd, nullptr);
+        }
+
+        return;
+    }
+#endif
+
+    if (static_cast<size_t>(id) < this->pollfds.size()) {
+        this->pollfds[id] = pollfd{.fd = -1, .events = 0, .revents = 0};
+    }
+}
+
+void Poller::WaitForOutgoing(SocketDescriptor sd, i32 id) {
+    // epoll is edge triggered and always watches both directions
+    if (this->backend == PollerBackend::POLL && static_cast<size_t>(id) < this->pollfds.size()) {
+        this->pollfds[id].events |= POLLOUT;
+    }
+}
+
+void Poller::Wait(Array<Event> &events, int timeout_ms) {
+#ifdef LINUX
+    if (this->backend == PollerBackend::EPOLL) {
+        while (true) {
+            auto count = epoll_wait(this->epoll_fd, this->epoll_events.data(), static_cast<int>(this->epoll_events.size()), timeout_ms);
+
+            for (int i = 0; i < count; ++i) {
+                const auto &event = this->epoll_events[i];
+                events.emplace_back(Event{
+                    static_cast<i32>(event.data.u64),
+                    (event.events & (EPOLLIN | EPOLLRDHUP)) != 0,
+                    (event.events & EPOLLOUT) != 0,
+                    (event.events & (EPOLLERR | EPOLLHUP)) != 0,
+                });
+            }
+
+            // A full buffer means there may be more
+            if (count < static_cast<int>(this->epoll_events.size())) {
+                return;
+            }
+
+            timeout_ms = 0;
+        }
+    }
+#endif
+
+    if (this->pollfds.empty() || Poll(this->pollfds.data(), static_cast<int>(this->pollfds.size()), timeout_ms) <= 0) {
+        return;
+    }
+
+    for (size_t id = 0; id < this->pollfds.size(); ++id) {
+        auto &fd = this->pollfds[id];
+
+        if (fd.fd == -1 || fd.revents == 0) {
+            continue;
+        }
+
+        auto outgoing = (fd.revents & POLLOUT) != 0;
+        if (outgoing) {
+            // Edge triggered like epoll, WaitForOutgoing arms it again
+            fd.events &= ~POLLOUT;
+        }
+
+        events.emplace_back(Event{
+            static_cast<i32>(id),
+            (fd.revents & POLLIN) != 0,
+            outgoing,
+            (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0,
+        });
+    }
+}
+
+}
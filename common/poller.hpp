@@ -0,0 +1,59 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_platform.hpp"
+
+namespace net {
+
+enum class PollerBackend : u8 {
+    POLL  = 0, // Every socket is checked on every Wait, works everywhere
+    EPOLL = 1, // Linux, Wait only costs as much as there are ready sockets
+    IO_URING = 2, // Linux 6.0, completions instead of readiness, see net::Uring. Not a Poller, falls back to EPOLL there.
+    COUNT
+};
+
+inline StringView ToString(PollerBackend backend) {
+    switch (backend) {
+        case PollerBackend::POLL:
+            return "poll";
+        case PollerBackend::EPOLL:
+            return "epoll";
+        case PollerBackend::IO_URING:
+            return "io_uring";
+        default:
+            return "(unknown)";
+    }
+}
+
+// Readiness of many sockets, each registered with an id of the owner. Edge triggered with every backend:
+// an event says a socket became readable or writable, the owner keeps that flag until recv or send would block
+// and only then waits for the next event. Sockets without events cost nothing with epoll.
+struct Poller {
+    struct Event {
+        i32 id;
+        bool incoming;
+        bool outgoing;
+        bool error;
+    };
+
+    Poller() = default;
+    ~Poller();
+    Poller(const Poller &) = delete;
+    Poller &operator=(const Poller &) = delete;
+
+    bool Start(PollerBackend backend); // Falls back to poll if the backend is not available
+    void Stop();
+    void Add(SocketDescriptor sd, i32 id);
+    void Remove(SocketDescriptor sd, i32 id); // Before the socket is closed
+    void WaitForOutgoing(SocketDescriptor sd, i32 id); // A send would block, report when there is space again
+    void Wait(Array<Event> &events, int timeout_ms); // Appends to events
+
+    PollerBackend backend = PollerBackend::POLL;
+    Array<pollfd> pollfds; // POLL, indexed by id
+#ifdef LINUX
+    int epoll_fd = -1;
+    Array<struct epoll_event> epoll_events; // EPOLL, output buffer of one epoll_wait call
+#endif
+};
+
+}
@@ -0,0 +1,47 @@
+#include "common/registry_snapshot.hpp"
+
+#include <cstring>
+
+// Appends the bytes as whole u64 words, returns the word offset
+static size_t AppendWords(Array<u64> &data, const void *bytes, size_t num_bytes) {
+    auto offset = data.size();
+    data.resize(offset + (num_bytes + sizeof(u64) - 1) / sizeof(u64));
+
+    if (num_bytes > 0) {
+        std::memcpy(data.data() + offset, bytes, num_bytes);
+    }
+
+    return offset;
+}
+
+void RegistrySnapshot::Capture(const EntityRegistry &registry) {
+    this->entities.assign(registry.impl.data(), registry.impl.data() + registry.impl.size());
+    this->destroyed = registry.impl.destroyed();
+    this->pools.clear();
+    this->data.clear();
+
+    registry.impl.visit([&](auto type_id) {
+        const auto &component_pool = g_component_pools.at(type_id);
+
+        Pool pool;
+        pool.type = type_id;
+        pool.size = component_pool.size(registry);
+        pool.entities_offset = AppendWords(this->data, component_pool.entities(registry), pool.size * sizeof(Entity));
+        pool.components_offset = AppendWords(this->data, component_pool.components(registry), pool.size * component_pool.component_size);
+        this->pools.emplace_back(pool);
+    });
+}
+
+void RegistrySnapshot::Restore(EntityRegistry &registry) const {
+    registry.impl.clear();
+    registry.impl.assign(this->entities.begin(), this->entities.end(), this->destroyed);
+
+    for (const auto &pool : this->pools) {
+        auto entities = reinterpret_cast<const Entity *>(this->data.data() + pool.entities_offset);
+        g_component_pools.at(pool.type).insert(registry, entities, entities + pool.size, this->data.data() + pool.components_offset);
+    }
+}
+
+size_t RegistrySnapshot::GetByteSize() const {
+    return this->entities.size() * sizeof(Entity) + this->pools.size() * sizeof(Pool) + this->data.size() * sizeof(u64);
+}
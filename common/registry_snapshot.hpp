@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+// A registry as two contiguous blobs: the entity list (including the free list, so restored ids and versions
+// are exact) and one data blob holding every pool as its packed entities followed by its raw components.
+// Capture and Restore are one bulk copy per pool, nothing is created one by one. A captured snapshot is never
+// modified by Restore, so any number of forks (prediction, rollback, save states) can start from the same one.
+struct RegistrySnapshot {
+    struct Pool {
+        EntityId type;
+        size_t size; // Number of components
+        size_t entities_offset; // In words of data
+        size_t components_offset; // In words of data, unused for empty components
+    };
+
+    void Capture(const EntityRegistry &registry);
+    void Restore(EntityRegistry &registry) const; // Replaces everything in the registry
+    size_t GetByteSize() const;
+
+    Array<Entity> entities;
+    Entity destroyed = entt::null; // Head of the free list
+    Array<Pool> pools;
+    Array<u64> data; // u64 words keep every component block aligned
+};
@@ -0,0 +1,324 @@
+#include "common/replication.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+static u16 FieldBit(ReplicatedField field) {
+    return static_cast<u16>(1u << static_cast<u32>(field));
+}
+
+constexpr u16 ALL_FIELDS = static_cast<u16>((1u << NUM_REPLICATED_FIELDS) - 1);
+
+void ReplicationSnapshot::Capture(EntityRegistry &registry) {
+    this->entities.clear();
+
+    for (auto entity : registry.View<CNetReplication>()) {
+        ReplicatedEntity state{entt::to_integral(entity)};
+
+        auto set = [&](ReplicatedField field, u32 value) {
+            state.fields |= FieldBit(field);
+            state.values[static_cast<size_t>(field)] = value;
+        };
+
+        if (registry.TryGet<CKinematic>(entity) == nullptr) {
+            if (auto position = registry.TryGet<CPosition>(entity)) {
+                set(ReplicatedField::POSITION_X, std::bit_cast<u32>(position->value.x));
+                set(ReplicatedField::POSITION_Y, std::bit_cast<u32>(position->value.y));
+            }
+
+            if (auto velocity = registry.TryGet<CVelocity>(entity)) {
+                set(ReplicatedField::VELOCITY_X, std::bit_cast<u32>(velocity->value.x));
+                set(ReplicatedField::VELOCITY_Y, std::bit_cast<u32>(velocity->value.y));
+            }
+        }
+
+        if (auto planet_position = registry.TryGet<CPlanetPosition>(entity)) {
+            set(ReplicatedField::PLANET_POSITION, std::bit_cast<u32>(planet_position->value));
+            set(ReplicatedField::PLANET_POSITION_DELTA, std::bit_cast<u32>(planet_position->delta));
+        }
+
+        if (auto tank = registry.TryGet<CTank>(entity)) {
+            set(ReplicatedField::TURRET_ROTATION, std::bit_cast<u32>(tank->turret_rotation));
+            set(ReplicatedField::TARGET_TURRET_ROTATION, std::bit_cast<u32>(tank->target_turret_rotation));
+            set(ReplicatedField::TURRET_FLAGS, tank->flags);
+            set(ReplicatedField::FUEL, std::bit_cast<u32>(tank->fuel));
+            set(ReplicatedField::WEAPON_TYPE, static_cast<u32>(tank->weapon_type));
+        }
+
+        if (auto health = registry.TryGet<CHealth>(entity)) {
+            set(ReplicatedField::HEALTH, std::bit_cast<u32>(health->value));
+            set(ReplicatedField::MAX_HEALTH, std::bit_cast<u32>(health->max));
+        }
+
+        if (state.fields != 0) {
+            this->entities.emplace_back(state);
+        }
+    }
+
+    std::sort(this->entities.begin(), this->entities.end(),
+        [](const ReplicatedEntity &a, const ReplicatedEntity &b) {
+            return a.entity < b.entity;
+        });
+}
+
+ReplicationSnapshot &ReplicationHistory::Push(u32 tick) {
+    return this->Insert(this->latest_id + 1, tick);
+}
+
+ReplicationSnapshot &ReplicationHistory::Insert(u32 id, u32 tick) {
+    assert(id > this->latest_id);
+
+    if (this->snapshots.size() != CAPACITY) {
+        this->snapshots.resize(CAPACITY);
+    }
+
+    this->latest_id = id;
+    auto &snapshot = this->snapshots[id % CAPACITY];
+    snapshot.id = id;
+    snapshot.tick = tick;
+    snapshot.entities.clear();
+    return snapshot;
+}
+
+const ReplicationSnapshot *ReplicationHistory::Get(u32 id) const {
+    if (id == 0 || id > this->latest_id || this->snapshots.empty()) {
+        return nullptr;
+    }
+
+    const auto &snapshot = this->snapshots[id % CAPACITY];
+    return snapshot.id == id ? &snapshot : nullptr;
+}
+
+const ReplicationSnapshot &ReplicationHistory::GetLatest() const {
+    assert(this->latest_id != 0);
+    return this->snapshots[this->latest_id % CAPACITY];
+}
+
+static void WriteFields(const ReplicatedEntity &state, u16 fields, Packet &packet) {
+    packet.WriteU32(state.entity);
+    packet.WriteU16(fields);
+
+    for (size_t i = 0; i < NUM_REPLICATED_FIELDS; ++i) {
+        if ((fields & (1u << i)) != 0) {
+            packet.WriteU32(state.values[i]);
+        }
+    }
+}
+
+// Both snapshots are sorted, so the baseline of every entity is found in one merge pass
+void WriteSnapshotDelta(const ReplicationSnapshot &current, const ReplicationSnapshot *baseline, Packet &packet) {
+    auto count_position = packet.buffer.size();
+    u32 count = 0;
+    packet.WriteU32(count);
+
+    Array<EntityId> removed;
+    size_t base = 0;
+
+    for (const auto &state : current.entities) {
+        const ReplicatedEntity *previous = nullptr;
+
+        if (baseline != nullptr) {
+            while (base < baseline->entities.size() && baseline->entities[base].entity < state.entity) {
+                removed.emplace_back(baseline->entities[base++].entity);
+            }
+
+            if (base < baseline->entities.size() && baseline->entities[base].entity == state.entity) {
+                previous = &baseline->entities[base++];
+            }
+        }
+
+        auto changed = state.fields;
+
+        if (previous != nullptr) {
+            for (size_t i = 0; i < NUM_REPLICATED_FIELDS; ++i) {
+                auto bit = static_cast<u16>(1u << i);
+                if ((previous->fields & bit) != 0 && previous->values[i] == state.values[i]) {
+                    changed &= ~bit;
+                }
+            }
+
+            // Components can go away, then the fields are missing from the rebuilt snapshot
+            if ((previous->fields & ~state.fields) != 0) {
+                removed.emplace_back(state.entity);
+                changed = state.fields;
+            }
+        }
+
+        if (changed == 0) {
+            continue;
+        }
+
+        WriteFields(state, changed, packet);
+        ++count;
+    }
+
+    if (baseline != nullptr) {
+        for (; base < baseline->entities.size(); ++base) {
+            removed.emplace_back(baseline->entities[base].entity);
+        }
+    }
+
+    std::memcpy(&packet.buffer[count_position], &count, sizeof(count));
+
+    std::sort(removed.begin(), removed.end());
+    packet.WriteU32(static_cast<u32>(removed.size()));
+
+    for (auto entity : removed) {
+        packet.WriteU32(entity);
+    }
+}
+
+bool ReadSnapshotDelta(const ReplicationSnapshot *baseline, Packet &packet, ReplicationSnapshot &output) {
+    assert(baseline != &output);
+
+    u32 count;
+    if (!packet.ReadU32(count)) {
+        return false;
+    }
+
+    // Read completely first, the removed entities come after the changed ones
+    Array<ReplicatedEntity> changed;
+
+    for (u32 i = 0; i < count; ++i) {
+        ReplicatedEntity state;
+        if (!packet.ReadU32(state.entity) || !packet.ReadU16(state.fields) || (state.fields & ~ALL_FIELDS) != 0) {
+            return false;
+        }
+
+        // Sorted like the snapshots, the merge below depends on it
+        if (!changed.empty() && changed.back().entity >= state.entity) {
+            return false;
+        }
+
+        for (size_t field = 0; field < NUM_REPLICATED_FIELDS; ++field) {
+            if ((state.fields & (1u << field)) != 0 && !packet.ReadU32(state.values[field])) {
+                return false;
+            }
+        }
+
+        if ((state.fields & FieldBit(ReplicatedField::WEAPON_TYPE)) != 0 &&
+            state.values[static_cast<size_t>(ReplicatedField::WEAPON_TYPE)] >= static_cast<u32>(Weapon::Type::COUNT)) {
+            return false;
+        }
+
+        changed.emplace_back(state);
+    }
+
+    u32 num_removed;
+    if (!packet.ReadU32(num_removed)) {
+        return false;
+    }
+
+    Array<EntityId> removed;
+
+    for (u32 i = 0; i < num_removed; ++i) {
+        EntityId entity;
+        if (!packet.ReadU32(entity) || (!removed.empty() && removed.back() >= entity)) {
+            return false;
+        }
+
+        removed.emplace_back(entity);
+    }
+
+    // Baseline minus the removed entities, overwritten by the changed fields
+    output.entities.clear();
+    size_t base = 0;
+    size_t next_removed = 0;
+
+    auto carry = [&](const ReplicatedEntity &state) {
+        while (next_removed < removed.size() && removed[next_removed] < state.entity) {
+            ++next_removed;
+        }
+
+        if (next_removed == removed.size() || removed[next_removed] != state.entity) {
+            output.entities.emplace_back(state);
+        }
+    };
+
+    for (const auto &state : changed) {
+        const ReplicatedEntity *previous = nullptr;
+
+        if (baseline != nullptr) {
+            while (base < baseline->entities.size() && baseline->entities[base].entity < state.entity) {
+                carry(baseline->entities[base++]);
+            }
+
+            if (base < baseline->entities.size() && baseline->entities[base].entity == state.entity) {
+                previous = &baseline->entities[base++];
+            }
+        }
+
+        auto removed_before = std::binary_search(removed.begin(), removed.end(), state.entity);
+        auto &merged = output.entities.emplace_back(previous != nullptr && !removed_before ? *previous : ReplicatedEntity{state.entity});
+        merged.fields |= state.fields;
+
+        for (size_t field = 0; field < NUM_REPLICATED_FIELDS; ++field) {
+            if ((state.fields & (1u << field)) != 0) {
+                merged.values[field] = state.values[field];
+            }
+        }
+    }
+
+    if (baseline != nullptr) {
+        for (; base < baseline->entities.size(); ++base) {
+            carry(baseline->entities[base]);
+        }
+    }
+
+    return true;
+}
+
+void ApplySnapshot(const ReplicationSnapshot &snapshot, EntityRegistry &registry) {
+    for (const auto &state : snapshot.entities) {
+        auto entity = Entity{state.entity};
+        if (!registry.IsValid(entity)) {
+            // Already destroyed here
+            continue;
+        }
+
+        auto has = [&](ReplicatedField field) {
+            return (state.fields & FieldBit(field)) != 0;
+        };
+
+        auto apply = [&](ReplicatedField field, f32 &target) {
+            if (has(field)) {
+                target = std::bit_cast<f32>(state.values[static_cast<size_t>(field)]);
+            }
+        };
+
+        if (auto position = registry.TryGet<CPosition>(entity)) {
+            apply(ReplicatedField::POSITION_X, position->value.x);
+            apply(ReplicatedField::POSITION_Y, position->value.y);
+        }
+
+        if (auto velocity = registry.TryGet<CVelocity>(entity)) {
+            apply(ReplicatedField::VELOCITY_X, velocity->value.x);
+            apply(ReplicatedField::VELOCITY_Y, velocity->value.y);
+        }
+
+        if (auto planet_position = registry.TryGet<CPlanetPosition>(entity)) {
+            apply(ReplicatedField::PLANET_POSITION, planet_position->value);
+            apply(ReplicatedField::PLANET_POSITION_DELTA, planet_position->delta);
+        }
+
+        if (auto tank = registry.TryGet<CTank>(entity)) {
+            apply(ReplicatedField::TURRET_ROTATION, tank->turret_rotation);
+            apply(ReplicatedField::TARGET_TURRET_ROTATION, tank->target_turret_rotation);
+            apply(ReplicatedField::FUEL, tank->fuel);
+
+            if (has(ReplicatedField::TURRET_FLAGS)) {
+                tank->flags = state.values[static_cast<size_t>(ReplicatedField::TURRET_FLAGS)];
+            }
+
+            if (has(ReplicatedField::WEAPON_TYPE)) {
+                tank->weapon_type = static_cast<Weapon::Type>(state.values[static_cast<size_t>(ReplicatedField::WEAPON_TYPE)]);
+            }
+        }
+
+        if (auto health = registry.TryGet<CHealth>(entity)) {
+            apply(ReplicatedField::HEALTH, health->value);
+            apply(ReplicatedField::MAX_HEALTH, health->max);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+#include "common/packet.hpp"
+
+// Fields of the CNetReplication entities that the server replicates, each one as a raw 32 bit word.
+// Kinematic bodies are left out of CPosition/CVelocity, the clients derive them like the server does.
+enum class ReplicatedField : u8 {
+    POSITION_X,
+    POSITION_Y,
+    VELOCITY_X,
+    VELOCITY_Y,
+    PLANET_POSITION,
+    PLANET_POSITION_DELTA,
+    TURRET_ROTATION,
+    TARGET_TURRET_ROTATION,
+    TURRET_FLAGS,
+    FUEL,
+    WEAPON_TYPE,
+    HEALTH,
+    MAX_HEALTH,
+    COUNT
+};
+
+constexpr size_t NUM_REPLICATED_FIELDS = static_cast<size_t>(ReplicatedField::COUNT);
+static_assert(NUM_REPLICATED_FIELDS <= 16, "The field masks are u16");
+
+struct ReplicatedEntity {
+    EntityId entity;
+    u16 fields = 0; // Mask of the fields the entity has
+    std::array<u32, NUM_REPLICATED_FIELDS> values{};
+};
+
+struct ReplicationSnapshot {
+    void Capture(EntityRegistry &registry);
+
+    u32 id = 0;
+    u32 tick = 0;
+    Array<ReplicatedEntity> entities; // Sorted by entity
+};
+
+// The last snapshots as a ring indexed by id, they are the baselines of the deltas. Whatever a client acknowledged
+// before the oldest one gets a full snapshot again. The server pushes what it captured, the client inserts what it
+// decoded under the server's ids. The arrays are reused once they have grown.
+struct ReplicationHistory {
+    constexpr static u32 CAPACITY = 32;
+    constexpr static u32 SNAPSHOT_INTERVAL = 3; // In ticks
+
+    // The cleared snapshot with the next id, Capture fills it
+    ReplicationSnapshot &Push(u32 tick);
+    // The cleared snapshot with the given id, which has to be newer than the latest
+    ReplicationSnapshot &Insert(u32 id, u32 tick);
+    const ReplicationSnapshot *Get(u32 id) const; // Null for 0 and once the snapshot left the ring
+    const ReplicationSnapshot &GetLatest() const;
+
+    Array<ReplicationSnapshot> snapshots;
+    u32 latest_id = 0; // 0 is no snapshot
+};
+
+// Only the entities that have fields differing from the baseline, with only those fields, followed by the entities
+// that are gone since the baseline. Entities that are new since the baseline are written with all fields, a null
+// baseline writes everything.
+void WriteSnapshotDelta(const ReplicationSnapshot &current, const ReplicationSnapshot *baseline, Packet &packet);
+
+// Rebuilds the complete snapshot from the baseline the delta was written against. The baseline has to be the
+// snapshot the server used, the client keeps the decoded ones in a ReplicationHistory.
+bool ReadSnapshotDelta(const ReplicationSnapshot *baseline, Packet &packet, ReplicationSnapshot &output);
+
+// Sets all fields of the snapshot, so it doesn't matter what was applied in between. Fields of entities or
+// components the registry doesn't have are skipped, the entities are created and destroyed by commands.
+void ApplySnapshot(const ReplicationSnapshot &snapshot, EntityRegistry &registry);
@@ -63,13 +63,19 @@ void TcpSocket::SetConnectedSocket(net::SocketDescriptor sd) {
 void TcpSocket::Push(const Packet &pkt) {
     assert(pkt.position > sizeof(Packet_Header));
     assert((reinterpret_cast<const Packet_Header *>(&pkt.buffer[0]))->size == pkt.position);
-    this->send.queue.emplace_back(pkt.buffer);
+    this->send.queue.emplace_back(std::make_shared<const Array<char>>(pkt.buffer));
 }
 
 void TcpSocket::Push(Packet &&pkt) {
     assert(pkt.position > sizeof(Packet_Header));
     assert((reinterpret_cast<const Packet_Header *>(&pkt.buffer[0]))->size == pkt.position);
-    this->send.queue.emplace_back(ToRvalue(pkt.buffer));
+    this->send.queue.emplace_back(std::make_shared<const Array<char>>(ToRvalue(pkt.buffer)));
+}
+
+void TcpSocket::Push(const PacketBuffer &buffer) {
+    assert(buffer != nullptr && buffer->size() > sizeof(Packet_Header));
+    assert((reinterpret_cast<const Packet_Header *>(buffer->data()))->size == buffer->size());
+    this->send.queue.emplace_back(buffer);
 }
 
 bool TcpSocket::Pop(Packet &out) {
@@ -125,29 +131,25 @@ SocketResult TcpSocket::DoSend() {
         this->Close(true);
     }
 
+    net::IoVec vecs[MAX_IOVECS];
+
     while (true) {
         if (this->state != Socket_State::CONNECTED) {
             return SocketResult::DONE;
         }
 
-        if (this->send.current.empty() && !this->send.queue.empty()) {
-            this->send.current = ToRvalue(this->send.queue.front());
-            this->send.queue.pop_front();
-            this->send.pos = 0;
-        }
+        if (this->send.IsFrameDone()) {
+            this->FinishFrame();
 
-        if (this->send.current.empty()) {
-            return SocketResult::DONE;
-        }
-
-        assert(this->send.pos < this->send.current.size());
+            if (this->send.queue.empty()) {
+                return SocketResult::DONE;
+            }
 
-        auto bytesleft = static_cast<int>(this->send.current.size() - this->send.pos);
-        if (bytesleft == 0) {
-            return SocketResult::DONE;
+            this->BuildFrame();
         }
 
-        auto sent = ::send(this->sd, &this->send.current[this->send.pos], bytesleft, 0);
+        auto count = this->send.FillIoVecs(vecs, MAX_IOVECS);
+        auto sent = net::SendVectored(this->sd, vecs, count);
 
         if (sent == -1) {
             if (!net::IsEWouldBlock()) {
@@ -159,17 +161,11 @@ SocketResult TcpSocket::DoSend() {
             return SocketResult::NOT_DONE;
         }
 
-        this->send.pos += sent;
         this->stats.bytes_sent += sent;
         TcpSocket::global_stats.bytes_sent += sent;
 
-        if (this->send.pos != this->send.current.size()) {
-            return SocketResult::NOT_DONE;
-        }
-
-        this->send.current.clear();
-        ++this->stats.packets_sent;
-        ++TcpSocket::global_stats.packets_sent;
+        // Keep going until send() would block, edge triggered polling only reports the socket again after that
+        this->send.Advance(static_cast<size_t>(sent));
     }
 }
 
@@ -214,25 +210,170 @@ SocketResult TcpSocket::DoRecv() {
         this->stats.bytes_received += received;
         TcpSocket::global_stats.bytes_received += received;
 
-        if (this->recv.pos != this->recv.current.size()) {
-            return SocketResult::NOT_DONE;
+        // Keep going until recv() would block, edge triggered polling only reports the socket again after that
+        if (this->recv.pos == this->recv.current.size()) {
+            this->CompleteRecv();
         }
+    }
+}
 
-        if (this->recv.current.size() == sizeof(Packet_Header)) {
-            Packet_Header hdr;
-            memcpy(&hdr, this->recv.current.data(), sizeof(Packet_Header));
+// The buffers are swapped, so the segments keep pointing into the packets and the prefix that out holds now
+void TcpSocket::TakeFrame(SendBuffer &out) {
+    out.ResetFrame();
 
-            if (hdr.size < sizeof(Packet_Header) || hdr.size > max_packet_size) {
-                assert(!"Invalid packet size");
-            }
+    if (this->send.IsFrameDone()) {
+        this->FinishFrame();
+
+        if (this->send.queue.empty()) {
+            return;
+        }
+
+        this->BuildFrame();
+    }
+
+    for (auto i = this->send.segment; i < this->send.segments.size(); ++i) {
+        auto size = this->send.segments[i].size - (i == this->send.segment ? this->send.pos : 0);
+        this->stats.bytes_sent += size;
+        TcpSocket::global_stats.bytes_sent += size;
+    }
+
+    this->stats.packets_sent += this->send.frame_packets.size();
+    TcpSocket::global_stats.packets_sent += this->send.frame_packets.size();
+
+    std::swap(out.frame_packets, this->send.frame_packets);
+    std::swap(out.frame_prefix, this->send.frame_prefix);
+    std::swap(out.segments, this->send.segments);
+    out.segment = this->send.segment;
+    out.pos = this->send.pos;
+    this->send.ResetFrame();
+}
+
+// Packs the queued messages into one frame, as many as fit. A single or a too large message goes out as it is.
+void TcpSocket::BuildFrame() {
+    assert(this->send.IsFrameDone() && !this->send.queue.empty());
+    this->send.ResetFrame();
+
+    size_t num_messages = 0;
+    size_t frame_size = sizeof(Packet_Header);
+
+    for (const auto &packet : this->send.queue) {
+        auto message_size = packet->size() - sizeof(Packet_Header);
+
+        if (message_size > Packet_Header::MAX_FRAMED_MESSAGE_SIZE || frame_size + sizeof(u16) + message_size > max_packet_size) {
+            break;
+        }
+
+        frame_size += sizeof(u16) + message_size;
+        ++num_messages;
+    }
+
+    if (num_messages <= 1) {
+        const auto &packet = this->send.frame_packets.emplace_back(ToRvalue(this->send.queue.front()));
+        this->send.queue.pop_front();
+        this->send.segments.emplace_back(SendBuffer::Segment{packet->data(), packet->size()});
+        return;
+    }
+
+    // The prefix is complete before the segments point into it
+    this->send.frame_prefix.resize(sizeof(Packet_Header) + num_messages * sizeof(u16));
+    Packet_Header hdr;
+    hdr.size = static_cast<u32>(frame_size) | Packet_Header::FRAME_FLAG;
+    memcpy(this->send.frame_prefix.data(), &hdr, sizeof(hdr));
+
+    for (size_t i = 0; i < num_messages; ++i) {
+        const auto &packet = this->send.frame_packets.emplace_back(ToRvalue(this->send.queue.front()));
+        this->send.queue.pop_front();
+
+        auto length = static_cast<u16>(packet->size() - sizeof(Packet_Header));
+        memcpy(&this->send.frame_prefix[sizeof(Packet_Header) + i * sizeof(u16)], &length, sizeof(length));
+    }
+
+    this->send.segments.emplace_back(SendBuffer::Segment{this->send.frame_prefix.data(), sizeof(Packet_Header)});
+
+    for (size_t i = 0; i < num_messages; ++i) {
+        const auto &packet = this->send.frame_packets[i];
+        this->send.segments.emplace_back(SendBuffer::Segment{&this->send.frame_prefix[sizeof(Packet_Header) + i * sizeof(u16)], sizeof(u16)});
+        this->send.segments.emplace_back(SendBuffer::Segment{packet->data() + sizeof(Packet_Header), packet->size() - sizeof(Packet_Header)});
+    }
+}
+
+void TcpSocket::FinishFrame() {
+    this->stats.packets_sent += this->send.frame_packets.size();
+    TcpSocket::global_stats.packets_sent += this->send.frame_packets.size();
+    this->send.ResetFrame();
+}
+
+void TcpSocket::Consume(const char *data, size_t size) {
+    this->stats.bytes_received += size;
+    TcpSocket::global_stats.bytes_received += size;
+
+    while (size > 0 && this->state == Socket_State::CONNECTED) {
+        if (this->recv.current.size() < sizeof(Packet_Header)) {
+            this->recv.current.resize(sizeof(Packet_Header));
+            this->recv.pos = 0;
+        }
+
+        auto count = std::min(size, this->recv.current.size() - this->recv.pos);
+        memcpy(&this->recv.current[this->recv.pos], data, count);
+        this->recv.pos += count;
+        data += count;
+        size -= count;
 
-            this->recv.current.resize(hdr.size);
-            //memcpy(this->recv.current.data(), &hdr, sizeof(packet_hdr));
-        } else {
-            this->recv.queue.emplace_back(ToRvalue(this->recv.current));
-            this->recv.current.clear();
-            ++this->stats.packets_received;
-            ++TcpSocket::global_stats.packets_received;
+        if (this->recv.pos == this->recv.current.size()) {
+            this->CompleteRecv();
         }
     }
 }
+
+// The header or the body of a packet is complete
+void TcpSocket::CompleteRecv() {
+    Packet_Header hdr;
+    memcpy(&hdr, this->recv.current.data(), sizeof(Packet_Header));
+    auto size = hdr.size & ~Packet_Header::FRAME_FLAG;
+
+    if (this->recv.current.size() == sizeof(Packet_Header)) {
+        if (size < sizeof(Packet_Header) || size > max_packet_size) {
+            assert(!"Invalid packet size");
+        }
+
+        this->recv.current.resize(size);
+        //memcpy(this->recv.current.data(), &hdr, sizeof(packet_hdr));
+    } else if (hdr.size & Packet_Header::FRAME_FLAG) {
+        this->SplitFrame();
+    } else {
+        this->recv.queue.emplace_back(ToRvalue(this->recv.current));
+        this->recv.current.clear();
+        ++this->stats.packets_received;
+        ++TcpSocket::global_stats.packets_received;
+    }
+}
+
+// Every message of a frame becomes a packet with its own header again, as if it was sent alone
+void TcpSocket::SplitFrame() {
+    const auto &frame = this->recv.current;
+    auto offset = sizeof(Packet_Header);
+
+    while (offset + sizeof(u16) <= frame.size()) {
+        u16 length;
+        memcpy(&length, &frame[offset], sizeof(length));
+        offset += sizeof(length);
+
+        if (offset + length > frame.size()) {
+            assert(!"Invalid frame");
+            break;
+        }
+
+        Packet_Header hdr;
+        hdr.size = static_cast<u32>(sizeof(Packet_Header) + length);
+
+        auto &packet = this->recv.queue.emplace_back(hdr.size);
+        memcpy(packet.data(), &hdr, sizeof(hdr));
+        memcpy(packet.data() + sizeof(hdr), &frame[offset], length);
+        offset += length;
+
+        ++this->stats.packets_received;
+        ++TcpSocket::global_stats.packets_received;
+    }
+
+    this->recv.current.clear();
+}
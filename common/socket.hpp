@@ -40,6 +40,74 @@ struct SocketBuffer {
     size_t pos = 0;
 };
 
+// A framed packet that is immutable once queued, so a broadcast is serialized once and every recipient's
+// socket only holds a reference to it and its own offset
+using PacketBuffer = SharedPtr<const Array<char>>;
+
+// Everything queued until a flush goes out as one frame of messages, see Packet_Header::FRAME_FLAG. The frame is
+// sent with vectored writes straight from the queued buffers, its segments point into them and into the prefix.
+struct SendBuffer {
+    struct Segment {
+        const char *data;
+        size_t size;
+    };
+
+    inline void Reset() {
+        this->queue.clear();
+        this->ResetFrame();
+    }
+
+    inline void ResetFrame() {
+        this->frame_packets.clear();
+        this->frame_prefix.clear();
+        this->segments.clear();
+        this->segment = 0;
+        this->pos = 0;
+    }
+
+    inline bool IsFrameDone() const {
+        return this->segment == this->segments.size();
+    }
+
+    inline bool IsEmpty() const {
+        return this->queue.empty() && this->IsFrameDone();
+    }
+
+    // The rest of the frame, at most max_count vectors. Returns how many were filled.
+    inline int FillIoVecs(net::IoVec *vecs, int max_count) const {
+        int count = 0;
+        for (auto i = this->segment; i < this->segments.size() && count < max_count; ++i, ++count) {
+            auto skip = i == this->segment ? this->pos : 0;
+            vecs[count] = net::MakeIoVec(this->segments[i].data + skip, this->segments[i].size - skip);
+        }
+
+        return count;
+    }
+
+    // After size bytes of the frame were sent
+    inline void Advance(size_t size) {
+        while (size > 0) {
+            auto rest = this->segments[this->segment].size - this->pos;
+
+            if (size >= rest) {
+                size -= rest;
+                ++this->segment;
+                this->pos = 0;
+            } else {
+                this->pos += size;
+                size = 0;
+            }
+        }
+    }
+
+    std::deque<PacketBuffer> queue;
+    Array<PacketBuffer> frame_packets; // Referenced by the segments
+    Array<char> frame_prefix; // The frame header and the message lengths
+    Array<Segment> segments;
+    size_t segment = 0; // The first that is not completely sent
+    size_t pos = 0; // Into segment
+};
+
 struct TcpSocket {
     ~TcpSocket();
     TcpSocket() = default;
@@ -74,16 +142,25 @@ struct TcpSocket {
     void SetConnectedSocket(net::SocketDescriptor sd);
     void Push(const Packet &packet);
     void Push(Packet &&packet);
+    void Push(const PacketBuffer &buffer);
     bool Pop(Packet &out);
     SocketResult DoConnect();
     SocketResult DoSend();
     SocketResult DoRecv();
+    void TakeFrame(SendBuffer &out); // For completion based I/O, out owns the next frame from then on
+    void Consume(const char *data, size_t size); // For completion based I/O, bytes that were received
+    void BuildFrame();
+    void FinishFrame();
+    void CompleteRecv();
+    void SplitFrame();
+
+    constexpr static int MAX_IOVECS = 64; // Per vectored send
 
     static SocketStats global_stats;
     SocketStats stats;
     net::SocketDescriptor sd = -1;
     Socket_State state = Socket_State::NONE;
     sockaddr_in remote_address;
-    SocketBuffer send;
+    SendBuffer send;
     SocketBuffer recv;
 };
@@ -0,0 +1,52 @@
+#include "common/spatial_hash.hpp"
+
+void SpatialHash::Clear() {
+    this->entries.clear();
+    this->cell_entries.clear();
+    this->bucket_starts.clear();
+}
+
+void SpatialHash::Insert(Entity entity, Vec2 position, f32 radius, u32 mask) {
+    this->entries.emplace_back(Entry{entity, position, radius, mask});
+}
+
+void SpatialHash::Build() {
+    this->cell_entries.clear();
+
+    for (u32 i = 0; i < this->entries.size(); ++i) {
+        const auto &entry = this->entries[i];
+        auto min_cell = this->GetCell(entry.position - entry.radius);
+        auto max_cell = this->GetCell(entry.position + entry.radius);
+
+        for (auto y = min_cell.y; y <= max_cell.y; ++y) {
+            for (auto x = min_cell.x; x <= max_cell.x; ++x) {
+                this->cell_entries.emplace_back(CellEntry{Vec2i{x, y}, i});
+            }
+        }
+    }
+
+    size_t num_buckets = 64;
+    while (num_buckets < this->cell_entries.size() * 2) {
+        num_buckets *= 2;
+    }
+
+    // Counting sort by bucket
+    this->bucket_starts.assign(num_buckets + 1, 0);
+
+    for (const auto &cell_entry : this->cell_entries) {
+        ++this->bucket_starts[this->GetBucket(cell_entry.cell) + 1];
+    }
+
+    for (size_t i = 1; i < this->bucket_starts.size(); ++i) {
+        this->bucket_starts[i] += this->bucket_starts[i - 1];
+    }
+
+    Array<u32> insert_positions(this->bucket_starts.begin(), this->bucket_starts.end() - 1);
+    Array<CellEntry> sorted(this->cell_entries.size());
+
+    for (const auto &cell_entry : this->cell_entries) {
+        sorted[insert_positions[this->GetBucket(cell_entry.cell)]++] = cell_entry;
+    }
+
+    this->cell_entries = ToRvalue(sorted);
+}
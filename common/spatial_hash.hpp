@@ -0,0 +1,142 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+// First contact of a circle moving along from + movement * t, t in [0, 1], with a circle at center. The collision
+// radius is the sum of both radii. Touching at the start counts as t = 0, like ForEachInRadius.
+inline Optional<f32> SweepCircle(Vec2 from, Vec2 movement, Vec2 center, f32 collision_radius) {
+    auto offset = from - center;
+    auto c = glm::dot(offset, offset) - collision_radius * collision_radius;
+
+    if (c < 0.0f) {
+        return 0.0f;
+    }
+
+    auto a = glm::dot(movement, movement);
+    auto b = glm::dot(offset, movement);
+    auto discriminant = b * b - a * c;
+
+    // Not moving, moving away or passing by
+    if (a == 0.0f || b >= 0.0f || discriminant < 0.0f) {
+        return std::nullopt;
+    }
+
+    auto t = (-b - std::sqrt(discriminant)) / a;
+    if (t > 1.0f) {
+        return std::nullopt;
+    }
+
+    return t;
+}
+
+// Uniform grid hashed into a fixed number of buckets. Meant to be refilled once per tick:
+// Clear(), Insert() everything, Build(), then query as often as needed.
+struct SpatialHash {
+    struct Entry {
+        Entity entity;
+        Vec2 position;
+        f32 radius;
+        u32 mask;
+    };
+
+    struct CellEntry {
+        Vec2i cell;
+        u32 entry;
+    };
+
+    explicit SpatialHash(f32 cell_size = 128.0f)
+        : cell_size(cell_size) {
+    }
+
+    void Clear();
+    void Insert(Entity entity, Vec2 position, f32 radius, u32 mask);
+    void Build();
+
+    inline Vec2i GetCell(Vec2 position) const {
+        return Vec2i{
+            static_cast<i32>(std::floor(position.x / this->cell_size)),
+            static_cast<i32>(std::floor(position.y / this->cell_size))
+        };
+    }
+
+    inline size_t GetBucket(Vec2i cell) const {
+        auto hash = (static_cast<u32>(cell.x) * 73856093u) ^ (static_cast<u32>(cell.y) * 19349663u);
+        return hash & (this->bucket_starts.size() - 2);
+    }
+
+    // Calls callback(const Entry &) once for every entry whose bounding box overlaps the rect
+    template<typename F>
+    void ForEachInRect(Vec2 min, Vec2 max, u32 mask, F &&callback) const {
+        if (this->entries.empty()) {
+            return;
+        }
+
+        auto min_cell = this->GetCell(min);
+        auto max_cell = this->GetCell(max);
+
+        for (auto y = min_cell.y; y <= max_cell.y; ++y) {
+            for (auto x = min_cell.x; x <= max_cell.x; ++x) {
+                Vec2i cell{x, y};
+                auto bucket = this->GetBucket(cell);
+
+                for (auto i = this->bucket_starts[bucket]; i < this->bucket_starts[bucket + 1]; ++i) {
+                    const auto &cell_entry = this->cell_entries[i];
+                    if (cell_entry.cell != cell) {
+                        continue;
+                    }
+
+                    const auto &entry = this->entries[cell_entry.entry];
+                    if ((entry.mask & mask) == 0) {
+                        continue;
+                    }
+
+                    // Large entries are stored in multiple cells, only report them in the first cell both boxes share
+                    auto entry_min_cell = this->GetCell(entry.position - entry.radius);
+                    if (glm::max(entry_min_cell, min_cell) != cell) {
+                        continue;
+                    }
+
+                    auto entry_min = entry.position - entry.radius;
+                    auto entry_max = entry.position + entry.radius;
+                    if (entry_max.x < min.x || entry_min.x > max.x || entry_max.y < min.y || entry_min.y > max.y) {
+                        continue;
+                    }
+
+                    callback(entry);
+                }
+            }
+        }
+    }
+
+    // Calls callback(const Entry &) once for every entry that is closer than radius + entry.radius
+    template<typename F>
+    void ForEachInRadius(Vec2 center, f32 radius, u32 mask, F &&callback) const {
+        this->ForEachInRect(center - radius, center + radius, mask,
+            [&](const Entry &entry) {
+                auto diff = entry.position - center;
+                auto collision_radius = radius + entry.radius;
+
+                if (diff.x * diff.x + diff.y * diff.y < collision_radius * collision_radius) {
+                    callback(entry);
+                }
+            });
+    }
+
+    // Calls callback(const Entry &, f32 t) for every entry a circle of the given radius touches while moving from
+    // from to to, t in [0, 1] is the first contact along the way
+    template<typename F>
+    void ForEachOnSegment(Vec2 from, Vec2 to, f32 radius, u32 mask, F &&callback) const {
+        this->ForEachInRect(glm::min(from, to) - radius, glm::max(from, to) + radius, mask,
+            [&](const Entry &entry) {
+                if (auto t = SweepCircle(from, to - from, entry.position, radius + entry.radius)) {
+                    callback(entry, t.value());
+                }
+            });
+    }
+
+    f32 cell_size;
+    Array<Entry> entries;
+    Array<CellEntry> cell_entries; // Sorted by bucket
+    Array<u32> bucket_starts; // bucket i owns cell_entries[bucket_starts[i], bucket_starts[i + 1])
+};
@@ -0,0 +1,75 @@
+#include "common/system_scheduler.hpp"
+
+#include "common/game_state.hpp"
+#include "common/worker_pool.hpp"
+
+void SystemScheduler::Add(const System &system) {
+    size_t stage = 0;
+
+    for (size_t i = 0; i < this->stages.size(); ++i) {
+        for (auto other : this->stages[i]) {
+            if (Conflicts(system, this->systems[other])) {
+                stage = i + 1;
+            }
+        }
+    }
+
+    if (stage == this->stages.size()) {
+        this->stages.emplace_back();
+    }
+
+    this->stages[stage].emplace_back(this->systems.size());
+    this->systems.emplace_back(system);
+    this->timings.emplace_back();
+}
+
+void SystemScheduler::Run(GameState &state, f32 dt, WorkerPool *pool) {
+    auto run_system = [&](size_t index) {
+        auto start = chrono::steady_clock::now();
+        (state.*this->systems[index].run)(dt);
+        auto ms = chrono::duration<f32, std::milli>(chrono::steady_clock::now() - start).count();
+
+        auto &timing = this->timings[index];
+        timing.last_ms = ms;
+        timing.average_ms = timing.average_ms * 0.95f + ms * 0.05f;
+        timing.max_ms = std::max(timing.max_ms, ms);
+    };
+
+    for (const auto &stage : this->stages) {
+        if (pool == nullptr || stage.size() == 1) {
+            for (auto index : stage) {
+                run_system(index);
+            }
+        } else {
+            pool->ParallelFor(stage.size(), [&](size_t i) { run_system(stage[i]); });
+        }
+    }
+}
+
+String SystemScheduler::FormatTimings() const {
+    String res;
+
+    for (size_t i = 0; i < this->stages.size(); ++i) {
+        for (auto index : this->stages[i]) {
+            const auto &timing = this->timings[index];
+            res += "[{}] {:<20} last {:7.3f}ms  avg {:7.3f}ms  max {:7.3f}ms\n"_format(
+                i, this->systems[index].name, timing.last_ms, timing.average_ms, timing.max_ms);
+        }
+    }
+
+    return res;
+}
+
+void SystemScheduler::ResetTimings() {
+    for (auto &timing : this->timings) {
+        timing = Timing{};
+    }
+}
+
+bool SystemScheduler::Conflicts(const System &a, const System &b) {
+    return
+        a.exclusive ||
+        b.exclusive ||
+        (a.writes & (b.reads | b.writes)) != 0 ||
+        (b.writes & a.reads) != 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+struct GameState;
+struct WorkerPool;
+
+// Access sets of the tick systems, one bit per component plus a few bits for non-component state
+template<typename T> constexpr u64 component_bit = 0;
+template<> constexpr u64 component_bit<CPosition>                  = u64{1} << 0;
+template<> constexpr u64 component_bit<CVelocity>                  = u64{1} << 1;
+template<> constexpr u64 component_bit<CMass>                      = u64{1} << 2;
+template<> constexpr u64 component_bit<CHealth>                    = u64{1} << 3;
+template<> constexpr u64 component_bit<CPlanet>                    = u64{1} << 4;
+template<> constexpr u64 component_bit<CTank>                      = u64{1} << 5;
+template<> constexpr u64 component_bit<CPlanetPosition>            = u64{1} << 6;
+template<> constexpr u64 component_bit<CCharging>                  = u64{1} << 7;
+template<> constexpr u64 component_bit<CProjectile>                = u64{1} << 8;
+template<> constexpr u64 component_bit<CTimeToLiveBeforeExplosion> = u64{1} << 9;
+template<> constexpr u64 component_bit<CFixedBody>                 = u64{1} << 10;
+template<> constexpr u64 component_bit<CWorldTransform>            = u64{1} << 11;
+template<> constexpr u64 component_bit<CPreviousPosition>          = u64{1} << 12;
+template<> constexpr u64 component_bit<CKinematic>                 = u64{1} << 13;
+
+template<typename ...Components>
+constexpr u64 components = (component_bit<Components> | ... | 0);
+
+namespace system_resource {
+    constexpr u64 BODY_ARRAYS   = u64{1} << 32;
+    constexpr u64 GRAVITY_TREE  = u64{1} << 33;
+    constexpr u64 BROADPHASE    = u64{1} << 34;
+    constexpr u64 INPUTS        = u64{1} << 35;
+    constexpr u64 GRAVITY_FIELD = u64{1} << 36;
+    constexpr u64 SUBSTEPS      = u64{1} << 37;
+    constexpr u64 KINEMATIC     = u64{1} << 38; // GameState::kinematic_sources
+    constexpr u64 TANK_HISTORY  = u64{1} << 39;
+}
+
+// Runs the registered systems in stages. A system is placed one stage after the last earlier system it
+// conflicts with, so conflicting systems keep their registration order and everything else may overlap.
+struct SystemScheduler {
+    struct System {
+        StringView name;
+        u64 reads = 0;
+        u64 writes = 0;
+        bool exclusive = false; // Creates or destroys entities, runs alone
+        void (GameState::*run)(f32 dt) = nullptr;
+    };
+
+    struct Timing {
+        f32 last_ms = 0.0f;
+        f32 average_ms = 0.0f;
+        f32 max_ms = 0.0f;
+    };
+
+    void Add(const System &system);
+    void Run(GameState &state, f32 dt, WorkerPool *pool);
+    String FormatTimings() const;
+    void ResetTimings();
+
+    static bool Conflicts(const System &a, const System &b);
+
+    Array<System> systems;
+    Array<Timing> timings;
+    Array<Array<size_t>> stages;
+};
@@ -0,0 +1,90 @@
+#include "common/tick_stats.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+void TickStats::SetPhases(Array<StringView> &&names) {
+    this->phase_names = ToRvalue(names);
+    this->samples.assign(NUM_SAMPLES * (this->phase_names.size() + 1), 0.0f);
+    this->current = 0;
+    this->num_filled = 0;
+    this->in_tick = false;
+}
+
+void TickStats::BeginTick() {
+    auto stride = this->phase_names.size() + 1;
+    std::fill_n(this->samples.begin() + this->current * stride, stride, 0.0f);
+    this->in_tick = true;
+}
+
+void TickStats::Record(size_t phase, f32 ms) {
+    assert(phase < this->phase_names.size());
+
+    if (this->in_tick) {
+        this->samples[this->current * (this->phase_names.size() + 1) + phase + 1] += ms;
+    }
+}
+
+void TickStats::EndTick(f32 budget_ms) {
+    if (!this->in_tick) {
+        return;
+    }
+
+    auto stride = this->phase_names.size() + 1;
+    auto row = this->samples.begin() + this->current * stride;
+    row[0] = std::accumulate(row + 1, row + stride, 0.0f);
+
+    this->last_total_ms = row[0];
+    this->num_ticks++;
+    if (row[0] > budget_ms) {
+        this->num_overruns++;
+    }
+
+    this->current = (this->current + 1) % NUM_SAMPLES;
+    this->num_filled = std::min(this->num_filled + 1, NUM_SAMPLES);
+    this->in_tick = false;
+}
+
+TickStats::Summary TickStats::GetSummary(StringView name) const {
+    Summary summary;
+    summary.name = name;
+    summary.num_ticks = this->num_ticks;
+    summary.num_overruns = this->num_overruns;
+
+    auto stride = this->phase_names.size() + 1;
+    Array<f32> column(this->num_filled);
+
+    for (size_t phase = 0; phase < stride; ++phase) {
+        auto &phase_summary = summary.phases.emplace_back();
+        phase_summary.name = phase == 0 ? "total" : this->phase_names[phase - 1];
+
+        if (column.empty()) {
+            continue;
+        }
+
+        for (size_t i = 0; i < this->num_filled; ++i) {
+            column[i] = this->samples[i * stride + phase];
+        }
+
+        // Nearest rank, the p99 of a short window is its maximum
+        auto p50 = column.begin() + (column.size() - 1) / 2;
+        auto p99 = column.begin() + (column.size() * 99 - 1) / 100;
+        std::nth_element(column.begin(), p50, column.end());
+        phase_summary.p50_ms = *p50;
+        std::nth_element(column.begin(), p99, column.end());
+        phase_summary.p99_ms = *p99;
+        phase_summary.max_ms = *std::max_element(column.begin(), column.end());
+    }
+
+    return summary;
+}
+
+String FormatTickStats(const TickStats::Summary &summary) {
+    auto result = "{}: {} ticks, {} overruns"_format(summary.name, summary.num_ticks, summary.num_overruns);
+
+    for (const auto &phase : summary.phases) {
+        result += "\n    {:<12} p50 {:7.3f} ms  p99 {:7.3f} ms  max {:7.3f} ms"_format(phase.name, phase.p50_ms, phase.p99_ms, phase.max_ms);
+    }
+
+    return result;
+}
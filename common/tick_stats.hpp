@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common/common.hpp"
+
+// Measures the time between laps, e.g. between the phases of a tick
+struct PhaseTimer {
+    inline PhaseTimer() : start(chrono::steady_clock::now()) {}
+
+    // Milliseconds since the construction or the previous lap
+    inline f32 Lap() {
+        auto now = chrono::steady_clock::now();
+        auto ms = chrono::duration<f32, std::milli>(now - this->start).count();
+        this->start = now;
+        return ms;
+    }
+
+    chrono::steady_clock::time_point start;
+};
+
+// Phase durations of the last NUM_SAMPLES ticks as a ring, so percentiles cover a rolling window and memory
+// stays constant. A tick whose phases add up to more than the budget counts as overrun.
+struct TickStats {
+    constexpr static size_t NUM_SAMPLES = 600; // Ten seconds at 60 ticks per second
+
+    struct PhaseSummary {
+        String name;
+        f32 p50_ms = 0.0f;
+        f32 p99_ms = 0.0f;
+        f32 max_ms = 0.0f;
+    };
+
+    struct Summary {
+        String name;
+        u32 num_ticks = 0; // Since the start
+        u32 num_overruns = 0; // Since the start
+        Array<PhaseSummary> phases; // The total comes first
+    };
+
+    void SetPhases(Array<StringView> &&names);
+    void BeginTick();
+    void Record(size_t phase, f32 ms); // Adds up when a phase is recorded several times per tick
+    void EndTick(f32 budget_ms);
+    Summary GetSummary(StringView name) const;
+
+    Array<StringView> phase_names;
+    Array<f32> samples; // NUM_SAMPLES rows of the total followed by the phases
+    size_t current = 0; // Row of the running tick
+    size_t num_filled = 0;
+    bool in_tick = false;
+    u32 num_ticks = 0;
+    u32 num_overruns = 0;
+    u32 num_reported_overruns = 0; // Up to which overrun the log already knows
+    f32 last_total_ms = 0.0f;
+};
+
+String FormatTickStats(const TickStats::Summary &summary);
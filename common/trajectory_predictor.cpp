@@ -0,0 +1,85 @@
+#include "common/trajectory_predictor.hpp"
+
+#include "common/game_state.hpp"
+#include "common/gravity.hpp"
+#include "common/spatial_hash.hpp"
+
+void TrajectoryPredictor::Capture(const GameState &state) {
+    this->planets.clear();
+    this->sun_position = state.GetSunPosition();
+    this->time = state.time;
+
+    // One prediction step is one simulation tick of the server, see Session::Tick
+    this->dt = static_cast<f32>(state.settings.deterministic ? 1 : state.settings.tick_interval);
+    this->leapfrog = !state.settings.deterministic && state.settings.integrator == Integrator::LEAPFROG;
+
+    state.entities.impl.view<const CPlanet, const CMass>().each(
+        [&](Entity entity, const CPlanet &planet, const CMass &mass) {
+            this->planets.emplace_back(Planet{planet.initial_position - this->sun_position, planet.orbital_velocity, mass.value, planet.radius});
+        });
+}
+
+bool TrajectoryPredictor::Predict(Vec2 position, Vec2 velocity, f32 mass, f32 radius, f32 duration, Array<Vec2> &output) {
+    // Same order as GameState::Tick: the kick sees the planets where the last orbit update left them, the collision
+    // test sees them after this tick's update
+    auto update_planets = [&](f32 time) {
+        this->planet_positions.resize(this->planets.size());
+
+        for (size_t i = 0; i < this->planets.size(); ++i) {
+            const auto &planet = this->planets[i];
+            this->planet_positions[i] = glm::rotate(planet.offset, time * planet.orbital_velocity) + this->sun_position;
+        }
+    };
+
+    auto compute_force = [&](Vec2 at) {
+        Vec2 force{};
+
+        for (size_t i = 0; i < this->planets.size(); ++i) {
+            auto diff = this->planet_positions[i] - at;
+            if (diff != Vec2{}) {
+                force += GravityForce(diff, mass, this->planets[i].mass);
+            }
+        }
+
+        return force;
+    };
+
+    auto time = this->time;
+    auto num_ticks = static_cast<size_t>(std::ceil(duration / this->dt));
+    update_planets(time);
+
+    for (size_t tick = 0; tick < num_ticks; ++tick) {
+        auto from = position;
+
+        if (this->leapfrog) {
+            position += velocity * (this->dt / 2.0f);
+            velocity += compute_force(position) * this->dt;
+            position += velocity * (this->dt / 2.0f);
+        } else {
+            position += velocity * this->dt;
+            velocity += compute_force(position) * this->dt;
+        }
+
+        time += this->dt;
+        update_planets(time);
+
+        // The first planet along the path ends it, like in TickCollision
+        auto first_contact = 2.0f;
+
+        for (size_t i = 0; i < this->planets.size(); ++i) {
+            auto t = SweepCircle(from, position - from, this->planet_positions[i], radius + this->planets[i].radius);
+            if (t.has_value()) {
+                first_contact = std::min(first_contact, t.value());
+            }
+        }
+
+        if (first_contact <= 1.0f) {
+            output.emplace_back(glm::mix(from, position, first_contact));
+            return true;
+        }
+
+        output.emplace_back(position);
+    }
+
+    return false;
+}
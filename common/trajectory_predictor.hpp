@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+struct GameState;
+
+// Compact copy of what a projectile path depends on: the planets as gravity sources and colliders plus the
+// integrator settings. Predicting doesn't touch the registry, so a path of a few hundred points costs
+// microseconds. Other projectiles are ignored, their attraction is tiny compared to the planets.
+struct TrajectoryPredictor {
+    struct Planet {
+        Vec2 offset; // From the sun, before the orbit rotation
+        f32 orbital_velocity;
+        f32 mass;
+        f32 radius;
+    };
+
+    void Capture(const GameState &state);
+
+    // Appends the position after every simulation tick until duration is over or the projectile hits a planet.
+    // Returns whether it hit a planet, the last point is the impact then.
+    bool Predict(Vec2 position, Vec2 velocity, f32 mass, f32 radius, f32 duration, Array<Vec2> &output);
+
+    Array<Planet> planets;
+    Array<Vec2> planet_positions;
+    Vec2 sun_position{};
+    f32 time = 0.0f;
+    f32 dt = 1.0f;
+    bool leapfrog = false;
+};
@@ -0,0 +1,80 @@
+#include "common/transform_history.hpp"
+
+#include <algorithm>
+
+static bool CompareSamples(const TransformHistory::Sample &a, const TransformHistory::Sample &b) {
+    return entt::to_integral(a.entity) < entt::to_integral(b.entity);
+}
+
+static const TransformHistory::Sample *FindSample(const TransformHistory::Frame &frame, Entity entity) {
+    auto it = std::lower_bound(frame.samples.begin(), frame.samples.end(), TransformHistory::Sample{entity, {}}, CompareSamples);
+
+    if (it == frame.samples.end() || it->entity != entity) {
+        return nullptr;
+    }
+
+    return &*it;
+}
+
+Array<TransformHistory::Sample> &TransformHistory::BeginFrame(u32 tick, size_t capacity) {
+    if (this->frames.size() != capacity) {
+        this->frames.clear();
+        this->frames.resize(capacity);
+    }
+
+    this->current = tick % capacity;
+    auto &frame = this->frames[this->current];
+    frame.tick = tick;
+    frame.valid = false;
+    frame.samples.clear();
+    return frame.samples;
+}
+
+void TransformHistory::EndFrame() {
+    auto &frame = this->frames[this->current];
+    std::sort(frame.samples.begin(), frame.samples.end(), CompareSamples);
+    frame.valid = true;
+    frame.max_step = 0.0f;
+
+    if (auto previous = this->GetFrame(frame.tick - 1)) {
+        for (const auto &sample : frame.samples) {
+            if (auto previous_sample = FindSample(*previous, sample.entity)) {
+                frame.max_step = std::max(frame.max_step, glm::distance(sample.position, previous_sample->position));
+            }
+        }
+    }
+
+    this->max_step = 0.0f;
+    for (const auto &other : this->frames) {
+        if (other.valid) {
+            this->max_step = std::max(this->max_step, other.max_step);
+        }
+    }
+}
+
+const TransformHistory::Frame *TransformHistory::GetFrame(u32 tick) const {
+    if (this->frames.empty()) {
+        return nullptr;
+    }
+
+    const auto &frame = this->frames[tick % this->frames.size()];
+    if (!frame.valid || frame.tick != tick) {
+        return nullptr;
+    }
+
+    return &frame;
+}
+
+Optional<Vec2> TransformHistory::GetPosition(Entity entity, u32 tick) const {
+    auto frame = this->GetFrame(tick);
+    if (frame == nullptr) {
+        return std::nullopt;
+    }
+
+    auto sample = FindSample(*frame, entity);
+    if (sample == nullptr) {
+        return std::nullopt;
+    }
+
+    return sample->position;
+}
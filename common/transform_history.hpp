@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+
+// World positions of the tanks over the last ticks, for lag compensated hits. The frames are a ring indexed by
+// tick, so memory is bounded by capacity * number of tanks and the arrays are reused once they have grown.
+// A lookup is one ring index plus a binary search over the tanks of that tick.
+struct TransformHistory {
+    struct Sample {
+        Entity entity;
+        Vec2 position;
+    };
+
+    struct Frame {
+        u32 tick = 0;
+        bool valid = false;
+        f32 max_step = 0.0f; // Largest distance a tank moved since the previous tick
+        Array<Sample> samples; // Sorted by entity
+    };
+
+    // Returns the cleared samples of the tick, EndFrame sorts them after they were filled
+    Array<Sample> &BeginFrame(u32 tick, size_t capacity);
+    void EndFrame();
+    const Frame *GetFrame(u32 tick) const;
+    Optional<Vec2> GetPosition(Entity entity, u32 tick) const;
+
+    // Upper bound for how far any tank moved over the last ticks, widens the broadphase query before rewinding
+    inline f32 GetMaxDisplacement(u32 num_ticks) const {
+        return this->max_step * static_cast<f32>(num_ticks);
+    }
+
+    Array<Frame> frames;
+    size_t current = 0;
+    f32 max_step = 0.0f; // Over all frames in the ring
+};
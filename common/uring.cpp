@@ -0,0 +1,330 @@
+#include "common/uring.hpp"
+
+#include "common/log.hpp"
+
+#if HAS_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <cstring>
+#endif
+
+namespace net {
+
+Uring::~Uring() {
+    this->Stop();
+}
+
+#if HAS_URING
+
+template<typename T>
+static T LoadAcquire(T *value) {
+    return std::atomic_ref<T>{*value}.load(std::memory_order_acquire);
+}
+
+template<typename T>
+static void StoreRelease(T *value, T new_value) {
+    std::atomic_ref<T>{*value}.store(new_value, std::memory_order_release);
+}
+
+bool Uring::Start() {
+    this->Stop();
+
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = NUM_COMPLETIONS;
+
+    this->ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, NUM_ENTRIES, &params));
+    if (this->ring_fd < 0) {
+        LogWarning("uring", "io_uring_setup failed: {}"_format(GetErrorString()));
+        this->ring_fd = -1;
+        return false;
+    }
+
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+        LogWarning("uring", "Kernel is too old, no single mmap");
+        this->Stop();
+        return false;
+    }
+
+    this->ring_size = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(u32),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    auto ring = mmap(nullptr, this->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQ_RING);
+
+    this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes = mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQES);
+
+    if (ring == MAP_FAILED || sqes == MAP_FAILED) {
+        LogWarning("uring", "Cannot map the rings: {}"_format(GetErrorString()));
+        this->ring = ring == MAP_FAILED ? nullptr : static_cast<u8 *>(ring);
+        this->sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe *>(sqes);
+        this->Stop();
+        return false;
+    }
+
+    this->ring = static_cast<u8 *>(ring);
+    this->sqes = static_cast<io_uring_sqe *>(sqes);
+    this->sq_head = reinterpret_cast<u32 *>(this->ring + params.sq_off.head);
+    this->sq_tail = reinterpret_cast<u32 *>(this->ring + params.sq_off.tail);
+    this->sq_mask = *reinterpret_cast<u32 *>(this->ring + params.sq_off.ring_mask);
+    this->sq_entries = params.sq_entries;
+    this->sq_array = reinterpret_cast<u32 *>(this->ring + params.sq_off.array);
+    this->cq_head = reinterpret_cast<u32 *>(this->ring + params.cq_off.head);
+    this->cq_tail = reinterpret_cast<u32 *>(this->ring + params.cq_off.tail);
+    this->cq_mask = *reinterpret_cast<u32 *>(this->ring + params.cq_off.ring_mask);
+    this->cqes = reinterpret_cast<io_uring_cqe *>(this->ring + params.cq_off.cqes);
+    this->local_sq_tail = *this->sq_tail;
+    this->num_to_submit = 0;
+
+    // The kernel picks a buffer from this ring for every receive, ReleaseBuffer hands it back
+    this->buffer_ring_size = NUM_BUFFERS * sizeof(io_uring_buf);
+    auto buffer_ring = mmap(nullptr, this->buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer_ring == MAP_FAILED) {
+        LogWarning("uring", "Cannot allocate the buffer ring: {}"_format(GetErrorString()));
+        this->Stop();
+        return false;
+    }
+
+    this->buffer_ring = static_cast<io_uring_buf_ring *>(buffer_ring);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<u64>(this->buffer_ring);
+    reg.ring_entries = NUM_BUFFERS;
+    reg.bgid = BUFFER_GROUP;
+
+    if (syscall(__NR_io_uring_register, this->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LogWarning("uring", "Kernel has no provided buffer rings: {}"_format(GetErrorString()));
+        this->Stop();
+        return false;
+    }
+
+    this->buffers.resize(NUM_BUFFERS * BUFFER_SIZE);
+    this->local_buffer_tail = 0;
+
+    for (u32 i = 0; i < NUM_BUFFERS; ++i) {
+        this->ReleaseBuffer(static_cast<u16>(i));
+    }
+
+    if (!this->TestMultishotRecv()) {
+        LogWarning("uring", "Kernel has no multishot recv");
+        this->Stop();
+        return false;
+    }
+
+    return true;
+}
+
+void Uring::Stop() {
+    if (this->buffer_ring != nullptr) {
+        munmap(this->buffer_ring, this->buffer_ring_size);
+        this->buffer_ring = nullptr;
+    }
+
+    if (this->sqes != nullptr) {
+        munmap(this->sqes, this->sqes_size);
+        this->sqes = nullptr;
+    }
+
+    if (this->ring != nullptr) {
+        munmap(this->ring, this->ring_size);
+        this->ring = nullptr;
+    }
+
+    if (this->ring_fd != -1) {
+        close(this->ring_fd);
+        this->ring_fd = -1;
+    }
+
+    this->buffers.clear();
+}
+
+bool Uring::IsRunning() const {
+    return this->ring_fd != -1;
+}
+
+io_uring_sqe *Uring::GetSqe() {
+    // Full, hand what is there to the kernel first
+    if (this->local_sq_tail - LoadAcquire(this->sq_head) >= this->sq_entries) {
+        this->Enter(0);
+    }
+
+    auto index = this->local_sq_tail & this->sq_mask;
+    this->sq_array[index] = index;
+    ++this->local_sq_tail;
+    ++this->num_to_submit;
+
+    auto sqe = &this->sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void Uring::AcceptMultishot(SocketDescriptor sd, u64 user_data) {
+    auto sqe = this->GetSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = sd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->user_data = user_data;
+}
+
+void Uring::RecvMultishot(SocketDescriptor sd, u64 user_data) {
+    auto sqe = this->GetSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = user_data;
+}
+
+void Uring::SendVectored(SocketDescriptor sd, Message &message, u64 user_data) {
+    message.header = {};
+    message.header.msg_iov = message.vecs.data();
+    message.header.msg_iovlen = message.vecs.size();
+
+    auto sqe = this->GetSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = sd;
+    sqe->addr = reinterpret_cast<u64>(&message.header);
+    sqe->len = 1;
+    sqe->user_data = user_data;
+}
+
+void Uring::Cancel(u64 user_data, u64 cancel_user_data) {
+    auto sqe = this->GetSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = user_data;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = cancel_user_data;
+}
+
+void Uring::Enter(u32 wait_for) {
+    StoreRelease(this->sq_tail, this->local_sq_tail);
+
+    // Always with GETEVENTS, cooperative task running only posts completions then
+    auto result = syscall(__NR_io_uring_enter, this->ring_fd, this->num_to_submit, wait_for, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+    if (result < 0) {
+        // Busy means the completion queue is full, the next Submit retries after reaping
+        if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+            LogError("uring", "io_uring_enter failed: {}"_format(GetErrorString()));
+        }
+
+        return;
+    }
+
+    this->num_to_submit -= std::min(this->num_to_submit, static_cast<u32>(result));
+}
+
+void Uring::Submit(Array<Completion> &completions, u32 wait_for) {
+    this->Enter(wait_for);
+
+    auto head = *this->cq_head;
+    auto tail = LoadAcquire(this->cq_tail);
+
+    for (; head != tail; ++head) {
+        const auto &cqe = this->cqes[head & this->cq_mask];
+
+        Completion completion{cqe.user_data, cqe.res, (cqe.flags & IORING_CQE_F_MORE) != 0};
+
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            completion.buffer_id = static_cast<u16>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            completion.data = &this->buffers[completion.buffer_id * BUFFER_SIZE];
+        }
+
+        completions.emplace_back(completion);
+    }
+
+    StoreRelease(this->cq_head, head);
+}
+
+void Uring::ReleaseBuffer(u16 buffer_id) {
+    // Not through bufs, its flexible array declaration has an offset in C++. And field by field, the tail of the
+    // ring overlays the reserved field of the first buffer.
+    auto &buffer = reinterpret_cast<io_uring_buf *>(this->buffer_ring)[this->local_buffer_tail & (NUM_BUFFERS - 1)];
+    buffer.addr = reinterpret_cast<u64>(&this->buffers[buffer_id * BUFFER_SIZE]);
+    buffer.len = BUFFER_SIZE;
+    buffer.bid = buffer_id;
+
+    ++this->local_buffer_tail;
+    StoreRelease(&this->buffer_ring->tail, this->local_buffer_tail);
+}
+
+// Multishot recv needs Linux 6.0, older kernels reject or finish it after the first completion
+bool Uring::TestMultishotRecv() {
+    int sds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sds) == -1) {
+        return false;
+    }
+
+    Array<Completion> completions;
+    this->RecvMultishot(sds[0], TEST_USER_DATA);
+    ::send(sds[1], "x", 1, 0);
+    this->Submit(completions, 1);
+
+    auto armed = false;
+    for (const auto &completion : completions) {
+        armed |= completion.user_data == TEST_USER_DATA && completion.result == 1 && completion.more;
+
+        if (completion.data != nullptr) {
+            this->ReleaseBuffer(completion.buffer_id);
+        }
+    }
+
+    // Wait for the last completion of the test, so that nothing is left for the user
+    this->Cancel(TEST_USER_DATA, TEST_USER_DATA - 1);
+
+    for (auto done = !armed; !done;) {
+        completions.clear();
+        this->Submit(completions, 1);
+
+        for (const auto &completion : completions) {
+            done |= completion.user_data == TEST_USER_DATA && !completion.more;
+
+            if (completion.data != nullptr) {
+                this->ReleaseBuffer(completion.buffer_id);
+            }
+        }
+    }
+
+    close(sds[0]);
+    close(sds[1]);
+
+    return armed;
+}
+
+#else
+
+bool Uring::Start() {
+    return false;
+}
+
+void Uring::Stop() {
+}
+
+bool Uring::IsRunning() const {
+    return false;
+}
+
+void Uring::AcceptMultishot(SocketDescriptor sd, u64 user_data) {
+}
+
+void Uring::RecvMultishot(SocketDescriptor sd, u64 user_data) {
+}
+
+void Uring::SendVectored(SocketDescriptor sd, Message &message, u64 user_data) {
+}
+
+void Uring::Cancel(u64 user_data, u64 cancel_user_data) {
+}
+
+void Uring::Submit(Array<Completion> &completions, u32 wait_for) {
+}
+
+void Uring::ReleaseBuffer(u16 buffer_id) {
+}
+
+#endif
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/net_platform.hpp"
+
+// The kernel headers need to be from Linux 6.0 for multishot recv and provided buffer rings, otherwise only the stubs
+// are built and Start fails. The client has no use for it.
+#if defined(LINUX) && !CLIENT && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_SETUP_COOP_TASKRUN) && defined(IORING_SETUP_SUBMIT_ALL)
+#define HAS_URING 1
+#else
+#define HAS_URING 0
+#endif
+
+namespace net {
+
+// Completion based socket I/O over io_uring, without liburing. Everything prepared during a tick goes to the kernel
+// with the single io_uring_enter of Submit, which also reaps what finished meanwhile, so the number of syscalls per
+// tick stays constant. Receives are multishot and land in a ring of provided buffers, a socket needs to be armed once.
+// Start fails on kernels (or platforms) without multishot recv, callers fall back to a Poller then.
+struct Uring {
+    constexpr static u32 NUM_ENTRIES = 4096;
+    constexpr static u32 NUM_COMPLETIONS = 4 * NUM_ENTRIES;
+    constexpr static u32 NUM_BUFFERS = 2048; // Power of two
+    constexpr static u32 BUFFER_SIZE = 4096;
+    constexpr static u16 BUFFER_GROUP = 0;
+
+    constexpr static int MAX_IOVECS = 1024; // IOV_MAX of Linux, per vectored send
+
+    // A vectored send. Like the data the vectors point to, it has to stay valid until the completion.
+    struct Message {
+        Array<IoVec> vecs;
+#if HAS_URING
+        msghdr header{};
+#endif
+    };
+
+    struct Completion {
+        u64 user_data;
+        i32 result; // Bytes, a descriptor or -errno
+        bool more; // A multishot request stays armed
+        const char *data = nullptr; // Received bytes in a provided buffer, until ReleaseBuffer
+        u16 buffer_id = 0;
+    };
+
+    Uring() = default;
+    ~Uring();
+    Uring(const Uring &) = delete;
+    Uring &operator=(const Uring &) = delete;
+
+    bool Start();
+    void Stop();
+    bool IsRunning() const;
+    void AcceptMultishot(SocketDescriptor sd, u64 user_data);
+    void RecvMultishot(SocketDescriptor sd, u64 user_data);
+    void SendVectored(SocketDescriptor sd, Message &message, u64 user_data);
+    void Cancel(u64 user_data, u64 cancel_user_data); // All requests with user_data
+    void Submit(Array<Completion> &completions, u32 wait_for = 0); // Appends to completions
+    void ReleaseBuffer(u16 buffer_id);
+
+#if HAS_URING
+    io_uring_sqe *GetSqe();
+    bool TestMultishotRecv();
+    void Enter(u32 wait_for);
+
+    constexpr static u64 TEST_USER_DATA = ~0ull;
+
+    int ring_fd = -1;
+    u8 *ring = nullptr; // Submission and completion queue share one mapping
+    size_t ring_size = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+    u32 *sq_head = nullptr;
+    u32 *sq_tail = nullptr;
+    u32 sq_mask = 0;
+    u32 sq_entries = 0;
+    u32 *sq_array = nullptr;
+    u32 *cq_head = nullptr;
+    u32 *cq_tail = nullptr;
+    u32 cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+    u32 local_sq_tail = 0; // Prepared but not yet published
+    u32 num_to_submit = 0;
+
+    io_uring_buf_ring *buffer_ring = nullptr;
+    size_t buffer_ring_size = 0;
+    u16 local_buffer_tail = 0;
+    Array<char> buffers;
+#endif
+};
+
+}
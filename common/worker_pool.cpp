@@ -0,0 +1,111 @@
+#include "common/worker_pool.hpp"
+
+#include "common/log.hpp"
+
+WorkerPool::~WorkerPool() {
+    this->Stop();
+}
+
+void WorkerPool::Start(size_t num_threads) {
+    this->Stop();
+    this->quit = false;
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        this->threads.emplace_back([this]() { this->WorkerMain(); });
+    }
+
+    LogInfo("worker pool", "Started {} worker threads"_format(num_threads));
+}
+
+void WorkerPool::Stop() {
+    {
+        std::lock_guard lock{this->mutex};
+        this->quit = true;
+    }
+
+    this->work_available.notify_all();
+
+    for (auto &thread : this->threads) {
+        thread.join();
+    }
+
+    this->threads.clear();
+}
+
+void WorkerPool::ParallelFor(size_t count, const Job &job) {
+    if (this->threads.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            job(i);
+        }
+
+        return;
+    }
+
+    {
+        std::unique_lock lock{this->mutex};
+
+        // Workers that woke up too late for the previous round must be gone before the counters are reset
+        this->work_done.wait(lock, [this]() { return this->num_busy == 0; });
+
+        this->job = &job;
+        this->count = count;
+        this->next_index = 0;
+        this->num_done = 0;
+        ++this->generation;
+    }
+
+    this->work_available.notify_all();
+    this->RunJobs(&job, count);
+
+    std::unique_lock lock{this->mutex};
+    this->work_done.wait(lock, [this, count]() { return this->num_done == count; });
+    this->job = nullptr;
+}
+
+void WorkerPool::WorkerMain() {
+    u64 seen_generation = 0;
+
+    while (true) {
+        const Job *job = nullptr;
+        size_t count = 0;
+
+        {
+            std::unique_lock lock{this->mutex};
+            this->work_available.wait(lock, [&]() { return this->quit || this->generation != seen_generation; });
+
+            if (this->quit) {
+                return;
+            }
+
+            seen_generation = this->generation;
+            job = this->job;
+            count = this->count;
+            ++this->num_busy;
+        }
+
+        this->RunJobs(job, count);
+
+        {
+            std::lock_guard lock{this->mutex};
+            --this->num_busy;
+        }
+
+        this->work_done.notify_all();
+    }
+}
+
+void WorkerPool::RunJobs(const Job *job, size_t count) {
+    while (true) {
+        auto index = this->next_index.fetch_add(1);
+        if (index >= count) {
+            return;
+        }
+
+        (*job)(index);
+
+        if (this->num_done.fetch_add(1) + 1 == count) {
+            std::lock_guard lock{this->mutex};
+            this->work_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common/common.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct WorkerPool {
+    using Job = std::function<void(size_t /*index*/)>;
+
+    WorkerPool() = default;
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void Start(size_t num_threads);
+    void Stop();
+
+    // Runs job(0) ... job(count - 1) on the workers and the calling thread, returns when all of them are done
+    void ParallelFor(size_t count, const Job &job);
+
+    inline size_t GetNumThreads() const {
+        return this->threads.size() + 1;
+    }
+
+    void WorkerMain();
+    void RunJobs(const Job *job, size_t count);
+
+    Array<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    const Job *job = nullptr;
+    size_t count = 0;
+    u64 generation = 0;
+    size_t num_busy = 0;
+    std::atomic<size_t> next_index = 0;
+    std::atomic<size_t> num_done = 0;
+    bool quit = false;
+};
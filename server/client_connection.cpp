@@ -27,6 +27,9 @@ void ClientConnection::Close(bool force, DisconnectReason reason, StringView mes
         }
     }
 
+    // The server frees garbage and flushes closed connections in its next tick
+    GetServer().Activate(*this);
+
     if (force) {
         this->socket.Close(false);
         this->garbage = true;
@@ -40,28 +43,32 @@ void ClientConnection::Close(bool force, DisconnectReason reason, StringView mes
     }
 }
 
-void ClientConnection::Tick(f32 dt, bool incoming, bool outgoing) {
-    if (incoming) {
+void ClientConnection::Tick(f32 dt) {
+    // The socket is drained until recv() would block, the next poll event says when there is more
+    if (this->readable && !this->uring) {
+        this->readable = false;
         this->socket.DoRecv();
     }
 
-    if (outgoing) {
-        this->socket.DoSend();
-        auto send_done = this->socket.send.queue.empty() && this->socket.send.current.empty();
+    auto send_done = this->socket.send.IsEmpty() && this->uring_send.IsFrameDone();
 
-        if (this->closed) {
-            auto timed_out =
-                chrono::high_resolution_clock::now() >
-                    this->closed_at + ClientConnection::last_packet_timeout;
+    if (this->writable && !this->uring && !send_done) {
+        this->writable = this->socket.DoSend() != SocketResult::NOT_DONE;
+        send_done = this->socket.send.IsEmpty();
+    }
 
-            if (send_done || timed_out) {
-                this->socket.Close(false);
-                this->garbage = true;
-            }
+    if (this->closed && !this->garbage) {
+        auto timed_out =
+            chrono::high_resolution_clock::now() >
+                this->closed_at + ClientConnection::last_packet_timeout;
+
+        if (send_done || timed_out) {
+            this->socket.Close(false);
+            this->garbage = true;
         }
     }
 
-    if (this->socket.state == Socket_State::ERROR) {
+    if (this->socket.state == Socket_State::ERROR && !this->closed) {
         this->Close(false, DisconnectReason::ERROR, "Socket error");
     }
 
@@ -92,6 +99,23 @@ void ClientConnection::Tick(f32 dt, bool incoming, bool outgoing) {
     }
 }
 
+bool ClientConnection::NeedsTick() const {
+    if (this->garbage) {
+        return false;
+    }
+
+    auto send_pending = !this->socket.send.IsEmpty();
+
+    // Server::SubmitSends only walks the active connections, so the rest of a partial send has to keep it there
+    return
+        this->readable ||
+        this->closed ||
+        this->next_state != nullptr ||
+        (this->state != nullptr && this->state->needs_tick) ||
+        (this->writable && !this->uring && send_pending) ||
+        (this->uring && (send_pending || !this->uring_send.IsFrameDone()));
+}
+
 void ClientConnection::SendPacket(Packet &&packet) {
     if (this->closed) {
         return;
@@ -99,16 +123,16 @@ void ClientConnection::SendPacket(Packet &&packet) {
 
     packet.WriteHeader();
     this->socket.Push(ToRvalue(packet));
-    GetServer().NotifySent(*this);
+    GetServer().Activate(*this);
 }
 
-void ClientConnection::SendPacketCopy(const Packet &packet) {
+void ClientConnection::SendSharedPacket(const PacketBuffer &buffer) {
     if (this->closed) {
         return;
     }
 
-    this->socket.Push(packet);
-    GetServer().NotifySent(*this);
+    this->socket.Push(buffer);
+    GetServer().Activate(*this);
 }
 
 void ClientConnection::SetNextState(UniquePtr<ClientConnectionState> state) {
@@ -4,6 +4,7 @@
 #include "common/packet.hpp"
 #include "common/net_msg.hpp"
 #include "common/socket.hpp"
+#include "common/uring.hpp"
 #include "common/disconnect_reason.hpp"
 
 struct ClientConnectionState;
@@ -13,9 +14,10 @@ struct ClientConnection {
     ~ClientConnection();
     void Start();
     void Close(bool force, DisconnectReason reason, StringView message);
-    void Tick(f32 dt, bool incoming, bool outgoing);
+    void Tick(f32 dt);
+    bool NeedsTick() const; // Whether the connection stays on the server's active list for the next tick
     void SendPacket(Packet &&packet);
-    void SendPacketCopy(const Packet &packet);
+    void SendSharedPacket(const PacketBuffer &buffer); // The framed packet is referenced, not copied
     void SetNextState(UniquePtr<ClientConnectionState> state);
 
     template<typename T>
@@ -39,10 +41,20 @@ struct ClientConnection {
     TcpSocket socket;
     bool garbage = false;
     bool closed = false;
+    bool readable = false; // Set by a poll event, cleared once recv() would block
+    bool writable = true; // Cleared once send() would block, set again by a poll event
+    bool is_active = false; // In Server::active_connections
+    bool uring = false; // Server::uring does the socket I/O, Tick only handles the packets
+    bool uring_send_in_flight = false;
+    bool uring_cancelled = false;
+    u32 num_uring_requests = 0; // The connection is only freed once the kernel is done with it
+    SendBuffer uring_send; // The frame in flight, owned here since the socket may be closed while the kernel still sends from it
+    net::Uring::Message uring_message;
     chrono::high_resolution_clock::time_point closed_at;
     std::array<f32, 32> time_diff_ringbuf{};
     std::size_t time_diff_ringbuf_pos = 0;
     std::array<f32, 32> rtt_ringbuf{};
     std::size_t rtt_ringbuf_pos = 0;
+    f32 rtt_avg = 0.0f; // Average over rtt_ringbuf, in server frames
     f32 time_last_speed_change_requested = 0.0f;
 };
@@ -18,6 +18,7 @@ struct ClientConnectionState {
 
     ClientConnection *connection;
     NetMessageHandlerMap net_message_handlers;
+    bool needs_tick = false; // Tick every server tick, otherwise only when the connection had traffic
 };
 
 
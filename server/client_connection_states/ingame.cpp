@@ -12,8 +12,13 @@ class IngameState : public ClientConnectionState {
         this->net_message_handlers.Add<NetMessageType::GAME_COMMAND>(&IngameState::handle_game_command, this);
         this->net_message_handlers.Add(&IngameState::handle_set_tick_length_message, this);
         this->net_message_handlers.Add(&IngameState::handle_pause_game_message, this);
+        this->net_message_handlers.Add(&IngameState::handle_tick_stats_request, this);
+        this->net_message_handlers.Add(&IngameState::handle_snapshot_ack_message, this);
         //this->net_message_handlers.add(&Ingame_State::handle_ping_message, this);
         this->net_message_handlers.Add(&IngameState::handle_pong_message, this);
+
+        // Pings go out every tick
+        this->needs_tick = true;
     }
 
     void End() override {
@@ -85,6 +90,32 @@ class IngameState : public ClientConnectionState {
         }
     }
 
+    void handle_tick_stats_request(TickStatsRequest &&message) {
+        if (this->connection->IsAdmin()) {
+            TickStatsResponse response;
+            GetServer().GetTickStats(response);
+            this->connection->Send(response);
+        } else {
+            this->connection->Close(false, DisconnectReason::INVALID, "Querying tick stats not allowed");
+        }
+    }
+
+    void handle_snapshot_ack_message(SnapshotAckMessage &&message) {
+        auto &con = *this->connection;
+        if (!con.session_id.has_value()) {
+            return;
+        }
+
+        auto session = GetServer().TryGetSession(con.session_id.value());
+        if (session == nullptr || session->state != SessionState::INGAME || !session->HasPlayer(con)) {
+            return;
+        }
+
+        if (!session->AckSnapshot(con, message.id)) {
+            con.Close(false, DisconnectReason::INVALID, "Invalid snapshot ack");
+        }
+    }
+
 #if 0
     void handle_ping_message(Ping_Message&& message) {
         Pong_Message response;
@@ -112,6 +143,7 @@ class IngameState : public ClientConnectionState {
         }
 
         rtt_avg /= con.rtt_ringbuf.size();
+        con.rtt_avg = rtt_avg;
         //DUMP(rtt_avg);
 
         auto half_rtt = rtt_avg / 2.0f;
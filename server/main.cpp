@@ -18,6 +18,28 @@ int main(int argc, char **argv) {
     int res = EXIT_SUCCESS;
     auto &server = GetServer();
 
+    for (int i = 1; i < argc; ++i) {
+        StringView arg{argv[i]};
+
+        if (arg == "--threads" && i + 1 < argc) {
+            server.num_worker_threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--poller" && i + 1 < argc) {
+            StringView backend{argv[++i]};
+
+            if (backend == "poll") {
+                server.poller_backend = net::PollerBackend::POLL;
+            } else if (backend == "epoll") {
+                server.poller_backend = net::PollerBackend::EPOLL;
+            } else if (backend == "io_uring") {
+                server.poller_backend = net::PollerBackend::IO_URING;
+            } else {
+                LogWarning("server main", "Unknown poller: {}"_format(backend));
+            }
+        } else {
+            LogWarning("server main", "Unknown argument: {}"_format(arg));
+        }
+    }
+
     if (!server.Start()) {
         LogError("server main", "Failed to initialize");
         res = 1;
@@ -0,0 +1,271 @@
+#include "server/npc_controller.hpp"
+
+#include "common/worker_pool.hpp"
+#include "server/server_game_state.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+
+static f32 GetAngleDistance(f32 a, f32 b) {
+    auto distance = std::fmod(std::abs(a - b), 360.0f);
+    return std::min(distance, 360.0f - distance);
+}
+
+// Inverse of the turret direction in GameState::Fire
+static f32 GetRotation(Vec2 direction) {
+    auto rotation = glm::degrees(std::atan2(direction.x, direction.y));
+    return rotation < 0.0f ? rotation + 360.0f : rotation;
+}
+
+void NpcController::Add(Entity tank) {
+    this->npcs.emplace_back(Npc{tank});
+}
+
+void NpcController::Tick(ServerGameState &state) {
+    auto it = std::remove_if(this->npcs.begin(), this->npcs.end(),
+        [&](const Npc &npc) {
+            return !state.entities.IsValid(npc.tank) || state.entities.TryGet<CTank>(npc.tank) == nullptr;
+        });
+    this->npcs.erase(it, this->npcs.end());
+
+    if (this->npcs.empty()) {
+        return;
+    }
+
+    this->Search(state);
+
+    for (auto &npc : this->npcs) {
+        this->Act(state, npc);
+    }
+}
+
+Entity NpcController::FindTarget(ServerGameState &state, Entity tank) const {
+    auto origin = state.entities.Get<CWorldTransform>(tank).position;
+    auto target = Entity{entt::null};
+    auto target_distance = std::numeric_limits<f32>::max();
+
+    state.entities.View<CTank, CWorldTransform>().each(
+        [&](Entity entity, CTank &, CWorldTransform &transform) {
+            auto distance = glm::distance(origin, transform.position);
+            if (entity != tank && distance < target_distance) {
+                target = entity;
+                target_distance = distance;
+            }
+        });
+
+    return target;
+}
+
+void NpcController::Search(ServerGameState &state) {
+    this->thinking.clear();
+    this->aims.clear();
+    this->candidates.clear();
+
+    // As many NPCs as the budget allows, at least one so that everyone gets a turn eventually
+    constexpr size_t candidates_per_npc = (NUM_COARSE_ANGLES + NUM_FINE_ANGLES) * NUM_CHARGES;
+    auto ms_per_npc = std::max(this->ms_per_candidate, 1e-6f) * candidates_per_npc;
+    auto max_thinking = std::max<size_t>(1, static_cast<size_t>(std::min(this->budget_ms / ms_per_npc, static_cast<f32>(this->npcs.size()))));
+    auto sun_position = state.GetSunPosition();
+    auto next_cursor = this->cursor;
+
+    for (size_t i = 0; i < this->npcs.size() && this->thinking.size() < max_thinking; ++i) {
+        auto index = (this->cursor + i) % this->npcs.size();
+        auto &npc = this->npcs[index];
+
+        if (npc.next_think_time > state.time) {
+            continue;
+        }
+
+        next_cursor = index + 1;
+        npc.next_think_time = state.time + THINK_INTERVAL;
+
+        auto target = this->FindTarget(state, npc.tank);
+        if (target != npc.target) {
+            npc.target = target;
+            npc.has_solution = false;
+        }
+
+        if (target == entt::null) {
+            continue;
+        }
+
+        const auto &tank = state.entities.Get<CTank>(npc.tank);
+        const auto &weapon = g_weapons[static_cast<size_t>(tank.weapon_type)];
+        const auto &transform = state.entities.Get<CWorldTransform>(npc.tank);
+        const auto &planet = state.entities.Get<CPlanet>(transform.planet);
+        const auto &target_transform = state.entities.Get<CWorldTransform>(target);
+        const auto &target_planet = state.entities.Get<CPlanet>(target_transform.planet);
+
+        Aim aim;
+        aim.origin = transform.position;
+        aim.origin_planet_offset = planet.initial_position - sun_position;
+        aim.origin_tank_offset = transform.offset;
+        aim.origin_orbital_velocity = planet.orbital_velocity;
+        aim.turret_rotation = tank.turret_rotation;
+        aim.cooldown = std::max(0.0f, tank.last_fire_time + weapon.cooldown - state.time);
+        aim.speed = weapon.speed;
+        aim.mass = weapon.projectile_mass;
+        aim.ttl = weapon.projectile_ttl;
+        aim.planet_offset = target_planet.initial_position - sun_position;
+        aim.tank_offset = target_transform.offset;
+        aim.orbital_velocity = target_planet.orbital_velocity;
+
+        auto aim_index = this->aims.size();
+        this->thinking.emplace_back(index);
+        this->aims.emplace_back(aim);
+
+        // The whole circle around the direct line, gravity bends the good shots far away from it
+        auto bearing = GetRotation(target_transform.position - aim.origin);
+
+        for (size_t angle = 0; angle < NUM_COARSE_ANGLES; ++angle) {
+            auto rotation = std::fmod(bearing + 360.0f * static_cast<f32>(angle) / NUM_COARSE_ANGLES, 360.0f);
+
+            for (auto charge : CHARGES) {
+                this->candidates.emplace_back(Candidate{aim_index, rotation, charge, 0.0f});
+            }
+        }
+
+        // Refine the last solution, the target and the planets only moved a little since
+        if (npc.has_solution) {
+            for (size_t angle = 0; angle < NUM_FINE_ANGLES; ++angle) {
+                auto offset = FINE_ANGLE_RANGE * (2.0f * static_cast<f32>(angle) / (NUM_FINE_ANGLES - 1) - 1.0f);
+                auto rotation = std::fmod(npc.rotation + offset + 360.0f, 360.0f);
+
+                for (auto charge : CHARGES) {
+                    this->candidates.emplace_back(Candidate{aim_index, rotation, charge, 0.0f});
+                }
+            }
+        }
+    }
+
+    this->cursor = next_cursor % this->npcs.size();
+
+    if (this->candidates.empty()) {
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+
+    this->predictor.Capture(state);
+
+    // Act sends the rotation, the charge and the fire as three commands, each one takes this long to be applied
+    auto command_delay = state.settings.deterministic ? static_cast<f32>(state.settings.input_delay_ticks) : 0.0f;
+
+    auto num_chunks = (this->candidates.size() + CANDIDATES_PER_CHUNK - 1) / CANDIDATES_PER_CHUNK;
+    this->chunk_predictors.resize(num_chunks);
+    this->chunk_paths.resize(num_chunks);
+
+    auto evaluate_chunk = [&](size_t chunk) {
+        auto &predictor = this->chunk_predictors[chunk];
+        auto &path = this->chunk_paths[chunk];
+        predictor = this->predictor;
+
+        auto end = std::min((chunk + 1) * CANDIDATES_PER_CHUNK, this->candidates.size());
+
+        for (auto i = chunk * CANDIDATES_PER_CHUNK; i < end; ++i) {
+            auto &candidate = this->candidates[i];
+            const auto &aim = this->aims[candidate.aim];
+
+            // The shot leaves once the turret has turned and the charge is complete, both planets orbit meanwhile
+            auto rotate_time = GetAngleDistance(aim.turret_rotation, candidate.rotation) / TURRET_SPEED;
+            auto launch_delay = std::max(rotate_time, aim.cooldown) + candidate.charge + 3.0f * command_delay;
+            predictor.time = this->predictor.time + std::ceil(launch_delay / predictor.dt) * predictor.dt;
+            auto origin = glm::rotate(aim.origin_planet_offset, predictor.time * aim.origin_orbital_velocity) + predictor.sun_position + aim.origin_tank_offset;
+
+            // Same launch velocity as GameState::Fire, without the spread
+            auto direction = glm::rotate(Vec2{0.0f, 1.0f}, -glm::radians(candidate.rotation));
+            auto velocity = direction * (candidate.charge / Weapon::MAX_CHARGE + 0.3f) / 1.3f * aim.speed;
+
+            path.clear();
+            predictor.Predict(origin, velocity, aim.mass, CProjectile{}.radius, aim.ttl, path);
+
+            candidate.miss = std::numeric_limits<f32>::max();
+            auto time = predictor.time;
+
+            for (auto point : path) {
+                time += predictor.dt;
+                auto target = glm::rotate(aim.planet_offset, time * aim.orbital_velocity) + predictor.sun_position + aim.tank_offset;
+                candidate.miss = std::min(candidate.miss, glm::distance(point, target));
+            }
+        }
+    };
+
+    if (state.worker_pool != nullptr) {
+        state.worker_pool->ParallelFor(num_chunks, evaluate_chunk);
+    } else {
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            evaluate_chunk(chunk);
+        }
+    }
+
+    // The candidates of an NPC are contiguous, keep the closest one
+    for (size_t i = 0; i < this->candidates.size();) {
+        auto best = i;
+
+        for (; i < this->candidates.size() && this->candidates[i].aim == this->candidates[best].aim; ++i) {
+            if (this->candidates[i].miss < this->candidates[best].miss) {
+                best = i;
+            }
+        }
+
+        const auto &candidate = this->candidates[best];
+        auto &npc = this->npcs[this->thinking[candidate.aim]];
+        npc.has_solution = candidate.miss <= CProjectile{}.hit_radius;
+        npc.rotation = candidate.rotation;
+        npc.charge = candidate.charge;
+        npc.miss = candidate.miss;
+    }
+
+    auto ms = chrono::duration<f32, std::milli>(chrono::steady_clock::now() - start).count();
+    this->ms_per_candidate = glm::mix(this->ms_per_candidate, ms / static_cast<f32>(this->candidates.size()), 0.2f);
+    this->num_searches += this->thinking.size();
+    this->num_candidates += this->candidates.size();
+}
+
+void NpcController::Act(ServerGameState &state, Npc &npc) {
+    if (!npc.has_solution || npc.wait_until > state.time) {
+        return;
+    }
+
+    GameState::CommandContext context;
+    context.tank = npc.tank;
+
+    // Lockstep inputs are applied input_delay_ticks later, don't send the same one again meanwhile
+    auto wait = state.settings.deterministic ? static_cast<f32>(state.settings.input_delay_ticks + 1) : 0.0f;
+
+    auto &tank = state.entities.Get<CTank>(npc.tank);
+
+    if (GetAngleDistance(tank.target_turret_rotation, npc.rotation) >= 0.01f) {
+        RotateTurretCommand rotate_turret;
+        rotate_turret.entity = entt::to_integral(npc.tank);
+        rotate_turret.target_rotation = npc.rotation;
+        state.HandleCommand(context, rotate_turret);
+        npc.wait_until = state.time + wait;
+        return;
+    }
+
+    if (GetAngleDistance(tank.turret_rotation, npc.rotation) > AIM_TOLERANCE) {
+        return;
+    }
+
+    const auto &weapon = g_weapons[static_cast<size_t>(tank.weapon_type)];
+    auto charging = state.entities.TryGet<CCharging>(npc.tank);
+
+    ChargeCommand charge;
+    charge.entity = entt::to_integral(npc.tank);
+
+    if (charging == nullptr) {
+        if (tank.last_fire_time + weapon.cooldown > state.time) {
+            return;
+        }
+
+        charge.fire = false;
+    } else if (state.time - charging->start_time >= npc.charge) {
+        charge.fire = true;
+    } else {
+        return;
+    }
+
+    state.HandleCommand(context, charge);
+    npc.wait_until = state.time + wait;
+}
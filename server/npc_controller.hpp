@@ -0,0 +1,81 @@
+#pragma once
+
+#include "common/common.hpp"
+#include "common/entity.hpp"
+#include "common/trajectory_predictor.hpp"
+
+struct ServerGameState;
+
+// Drives the NPC tanks of a session through the same commands a player sends. The NPCs that are due this tick
+// search for a firing solution together: their candidate turret angles and charges are one flat batch that is
+// predicted on the worker pool with the projectile integrator. The batch is sized from the measured cost per
+// candidate, so many NPCs are spread over several ticks instead of stretching one.
+struct NpcController {
+    constexpr static size_t NUM_COARSE_ANGLES = 32;
+    constexpr static size_t NUM_FINE_ANGLES = 8;
+    constexpr static f32 FINE_ANGLE_RANGE = 6.0f; // Degrees to each side of the last solution
+    constexpr static f32 CHARGES[] = {15.0f, 30.0f, 45.0f, 60.0f};
+    constexpr static size_t NUM_CHARGES = sizeof(CHARGES) / sizeof(CHARGES[0]);
+    constexpr static size_t CANDIDATES_PER_CHUNK = 16;
+    constexpr static f32 THINK_INTERVAL = 60.0f; // Time between two searches of the same NPC
+    constexpr static f32 AIM_TOLERANCE = 1.0f; // Degrees
+    constexpr static f32 TURRET_SPEED = 1.0f; // Degrees per time unit, see GameState::TickTurretRotation
+
+    struct Npc {
+        Entity tank = entt::null;
+        Entity target = entt::null;
+        f32 next_think_time = 0.0f;
+        bool has_solution = false;
+        f32 rotation = 0.0f;
+        f32 charge = 0.0f;
+        f32 miss = 0.0f; // Closest distance of the solution to the target
+        f32 wait_until = 0.0f; // Lockstep inputs take a few ticks until they are applied
+    };
+
+    struct Candidate {
+        size_t aim; // Index into aims
+        f32 rotation;
+        f32 charge;
+        f32 miss;
+    };
+
+    // Shooter and target of one thinking NPC. Both move with the orbits of their planets.
+    struct Aim {
+        Vec2 origin; // Where the shooter is now
+        Vec2 origin_planet_offset; // Shooter planet from the sun, before the orbit rotation
+        Vec2 origin_tank_offset; // Shooter from its planet center
+        f32 origin_orbital_velocity;
+        f32 turret_rotation;
+        f32 cooldown; // Until the weapon can be charged again
+        f32 speed;
+        f32 mass;
+        f32 ttl;
+        Vec2 planet_offset; // Target planet from the sun, before the orbit rotation
+        Vec2 tank_offset; // Target from its planet center
+        f32 orbital_velocity;
+    };
+
+    void Add(Entity tank);
+    void Tick(ServerGameState &state);
+
+    Array<Npc> npcs;
+    size_t cursor = 0; // Round robin over npcs, the next one to think
+    f32 budget_ms = 2.0f; // Search time per tick for all NPCs together
+    f32 ms_per_candidate = 0.01f; // Moving average of the measured search cost
+
+    // Reused between ticks
+    TrajectoryPredictor predictor;
+    Array<TrajectoryPredictor> chunk_predictors; // Predict uses scratch memory, one copy per chunk
+    Array<Array<Vec2>> chunk_paths;
+    Array<size_t> thinking; // Indices into npcs
+    Array<Aim> aims; // Parallel to thinking
+    Array<Candidate> candidates;
+
+    // For the development log
+    size_t num_searches = 0;
+    size_t num_candidates = 0;
+
+    Entity FindTarget(ServerGameState &state, Entity tank) const;
+    void Search(ServerGameState &state);
+    void Act(ServerGameState &state, Npc &npc);
+};
@@ -7,7 +7,22 @@
 #include "common/log.hpp"
 #include "common/frame_timer.hpp"
 
-Server::Server() = default;
+// What a request of Server::uring was for, with the client id in the upper bits of its user data
+enum class UringOp : u8 {
+    ACCEPT = 0,
+    RECV   = 1,
+    SEND   = 2,
+    CANCEL = 3,
+};
+
+static u64 MakeUserData(UringOp op, i32 client_id) {
+    return (static_cast<u64>(client_id) << 8) | static_cast<u64>(op);
+}
+
+Server::Server() {
+    this->tick_stats.SetPhases({"poll", "connections", "sessions"});
+}
+
 Server::~Server() = default;
 
 bool Server::Start() {
@@ -31,21 +46,43 @@ bool Server::Start() {
         return false;
     }
 
-    if (::listen(this->sd, this->clients.size()) == -1) {
+    if (::listen(this->sd, SOMAXCONN) == -1) {
         LogError("server", "Unable to listen on socket");
         return false;
     }
 
+    auto use_uring = this->poller_backend == net::PollerBackend::IO_URING && this->uring.Start();
+
+    if (!use_uring && !this->poller.Start(this->poller_backend)) {
+        LogWarning("server", "Poller {} is not available"_format(net::ToString(this->poller_backend)));
+    }
+
     LogInfo("server", "Server running on port {}"_format(ntohs(svaddr.sin_port)));
+    LogInfo("server", "Poller: {}"_format(net::ToString(use_uring ? net::PollerBackend::IO_URING : this->poller.backend)));
+    LogInfo("server", "Body kernel: {}"_format(GetBodyKernelName()));
+
+    // The main thread takes part in ticking the sessions too
+    auto hardware_threads = static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()));
+    this->worker_pool.Start(this->num_worker_threads.value_or(hardware_threads) - 1);
 
     // The server is the first "client".
     // This means that there would be also a client_connection allocated in the Connections array which is not used.
     this->clients.emplace_back();
-    this->pollfds.emplace_back(pollfd{.fd = this->sd, .events = POLLIN});
+
+    if (use_uring) {
+        this->uring.AcceptMultishot(this->sd, MakeUserData(UringOp::ACCEPT, 0));
+    } else {
+        this->poller.Add(this->sd, 0);
+    }
 
 #if defined(DEVELOPMENT) && DEVELOPMENT
     this->CreateSession("developer",            {},      1,  1, true);
     this->CreateSession("Marcel D'avis",        {},      2,  4, true);
+    this->CreateSession("Barnes Hut",           {},      1,  4, true, SimSettings{.gravity_solver = GravitySolver::BARNES_HUT});
+    this->CreateSession("Gravity field",        {},      1,  4, true, SimSettings{.gravity_solver = GravitySolver::FIELD});
+    this->CreateSession("Leapfrog 30 Hz",       {},      1,  4, true, SimSettings{.integrator = Integrator::LEAPFROG, .tick_interval = 2});
+    this->CreateSession("Lockstep",             {},      2,  0, true, SimSettings{.deterministic = true});
+    this->CreateSession("Hitscan machinegun",   {},      1,  4, true, SimSettings{.hitscan_machinegun = true});
     /*this->CreateSession("Martin Sonneborn",     {},      2,  1, true);
     this->CreateSession("Donarudo Terampu",     "12345", 1,  0, false);
     this->CreateSession("Boris JSON",           "12345", 1,  0, false);
@@ -111,60 +148,302 @@ void Server::Tick() {
     }
 #endif
 
-    net::Poll(&this->pollfds[0], this->pollfds.size(), 0);
+    this->tick_stats.BeginTick();
+    PhaseTimer timer;
 
-    assert(!(this->pollfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)));
-    if (this->pollfds[0].revents & POLLIN) {
-        this->DoAccept();
+    auto dt = GetFrameTimer().dt;
+
+    if (!this->uring.IsRunning()) {
+        this->PollEvents();
+        this->tick_stats.Record(PHASE_POLL, timer.Lap());
     }
 
-    auto dt = GetFrameTimer().dt;
+    this->TickConnections(dt);
+    this->tick_stats.Record(PHASE_CONNECTIONS, timer.Lap());
 
-    for (i32 client_id = 1; client_id < static_cast<i32>(this->clients.size()); ++client_id) {
-        auto &con = this->clients[client_id];
-        if (con == nullptr) {
-            continue;
+    this->TickSessions(dt);
+    this->tick_stats.Record(PHASE_SESSIONS, timer.Lap());
+
+    // At the end, so everything this tick sent goes out with the one io_uring_enter
+    if (this->uring.IsRunning()) {
+        this->SubmitSends();
+        this->ReapCompletions();
+        this->tick_stats.Record(PHASE_POLL, timer.Lap());
+    }
+
+    this->tick_stats.EndTick(chrono::duration<f32, std::milli>(GetFrameTimer().GetTickLength()).count());
+
+    if (this->tick_stats.num_ticks % TickStats::NUM_SAMPLES == 0) {
+        this->LogTickOverruns();
+    }
+}
+
+// Only the loop and the sessions that overran since the last report, so a loaded box points at its slow matches
+void Server::LogTickOverruns() {
+    auto log_overruns = [](TickStats &tick_stats, StringView name) {
+        if (tick_stats.num_overruns != tick_stats.num_reported_overruns) {
+            LogWarning("server", "{} overruns, tick timings of {}"_format(
+                tick_stats.num_overruns - tick_stats.num_reported_overruns, FormatTickStats(tick_stats.GetSummary(name))));
+            tick_stats.num_reported_overruns = tick_stats.num_overruns;
         }
+    };
 
-        auto &fd = this->pollfds[client_id];
+    log_overruns(this->tick_stats, "server");
 
-        if (con->garbage) {
-            fd.fd = -1;
-            fd.events = 0;
-            con.reset();
-        } else {
-            if (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                if (!con->closed) {
-                    con->Close(false, DisconnectReason::ERROR, "poll error");
-                }
+    for (auto &session : this->sessions) {
+        if (session != nullptr) {
+            log_overruns(session->tick_stats, "session {} '{}'"_format(session->id, session->name));
+        }
+    }
+}
 
-                continue;
-            }
+void Server::GetTickStats(TickStatsResponse &output) const {
+    output.summaries.emplace_back(this->tick_stats.GetSummary("server"));
 
-            auto incoming = (fd.revents & POLLIN) != 0;
-            auto outgoing = (fd.revents & POLLOUT) != 0;
-            con->Tick(dt, incoming, outgoing);
+    for (const auto &session : this->sessions) {
+        if (session != nullptr && session->state == SessionState::INGAME) {
+            output.summaries.emplace_back(session->tick_stats.GetSummary("session {} '{}'"_format(session->id, session->name)));
         }
     }
+}
+
+void Server::TickSessions(f32 dt) {
+    this->sessions_to_tick.clear();
 
     for (auto &session : this->sessions) {
         if (session != nullptr) {
             if (session->state == SessionState::GARBAGE) {
                 LogInfo("server", "Removing garbage session {}"_format(session->id));
                 session.reset();
+            } else if (session->state == SessionState::INGAME) {
+                this->sessions_to_tick.emplace_back(session.get());
+            }
+        }
+    }
+
+    for (auto session : this->sessions_to_tick) {
+        session->defer_broadcasts = true;
+    }
+
+    // Sessions don't share any state, so they can be ticked concurrently.
+    // Everything that touches connections is collected in the session outboxes and sent afterwards.
+    // A single session gets the pool for its systems instead.
+    if (this->sessions_to_tick.size() == 1) {
+        this->sessions_to_tick[0]->Tick(dt, &this->worker_pool);
+    } else {
+        this->worker_pool.ParallelFor(this->sessions_to_tick.size(), [&](size_t i) {
+            this->sessions_to_tick[i]->Tick(dt);
+        });
+    }
+
+    for (auto session : this->sessions_to_tick) {
+        session->defer_broadcasts = false;
+        session->FlushOutbox();
+    }
+}
+
+void Server::PollEvents() {
+    this->poll_events.clear();
+    this->poller.Wait(this->poll_events, 0);
+
+    for (const auto &event : this->poll_events) {
+        if (event.id == 0) {
+            assert(!event.error);
+
+            // Edge triggered, so everybody waiting has to be accepted now
+            while (this->DoAccept()) {
+            }
+
+            continue;
+        }
+
+        auto con = this->TryGetConnection(event.id);
+        if (con == nullptr || con->garbage) {
+            continue;
+        }
+
+        if (event.error) {
+            if (!con->closed) {
+                con->Close(false, DisconnectReason::ERROR, "poll error");
+            }
+
+            continue;
+        }
+
+        con->readable |= event.incoming;
+        con->writable |= event.outgoing;
+        this->Activate(*con);
+    }
+}
+
+void Server::SubmitSends() {
+    for (auto client_id : this->active_connections) {
+        auto con = this->TryGetConnection(client_id);
+
+        if (con == nullptr || !con->uring || con->uring_send_in_flight || con->garbage) {
+            continue;
+        }
+
+        // Straight from the shared packets, like TcpSocket::DoSend
+        if (con->uring_send.IsFrameDone()) {
+            con->socket.TakeFrame(con->uring_send);
+        }
+
+        if (con->uring_send.IsFrameDone() || con->socket.sd == -1) {
+            con->uring_send.ResetFrame();
+            continue;
+        }
+
+        auto &vecs = con->uring_message.vecs;
+        vecs.resize(net::Uring::MAX_IOVECS);
+        vecs.resize(con->uring_send.FillIoVecs(vecs.data(), net::Uring::MAX_IOVECS));
+
+        this->uring.SendVectored(con->socket.sd, con->uring_message, MakeUserData(UringOp::SEND, client_id));
+        con->uring_send_in_flight = true;
+        ++con->num_uring_requests;
+    }
+}
+
+void Server::ReapCompletions() {
+    this->completions.clear();
+    this->uring.Submit(this->completions);
+
+    for (const auto &completion : this->completions) {
+        auto op = static_cast<UringOp>(completion.user_data & 0xff);
+        auto client_id = static_cast<i32>(completion.user_data >> 8);
+
+        if (op == UringOp::ACCEPT) {
+            if (completion.result >= 0) {
+                sockaddr_in client_address{};
+                socklen_t length = sizeof(client_address);
+                getpeername(completion.result, reinterpret_cast<sockaddr *>(&client_address), &length);
+                this->AddClient(completion.result, client_address);
+            } else {
+                LogWarning("server", "Failed to accept client: {}"_format(strerror(-completion.result)));
+            }
+
+            if (!completion.more) {
+                this->uring.AcceptMultishot(this->sd, MakeUserData(UringOp::ACCEPT, 0));
+            }
+
+            continue;
+        }
+
+        auto con = op == UringOp::RECV || op == UringOp::SEND ? this->TryGetConnection(client_id) : nullptr;
+
+        if (op == UringOp::RECV) {
+            if (con != nullptr && !con->garbage && completion.result > 0) {
+                con->socket.Consume(completion.data, completion.result);
+            }
+
+            if (completion.data != nullptr) {
+                this->uring.ReleaseBuffer(completion.buffer_id);
+            }
+
+            if (con == nullptr || completion.more) {
+                if (con != nullptr) {
+                    this->Activate(*con);
+                }
+
+                continue;
+            }
+
+            --con->num_uring_requests;
+
+            if (!con->garbage) {
+                if (completion.result == -ENOBUFS) {
+                    // All buffers were taken, the rest is still in the socket
+                    this->uring.RecvMultishot(con->socket.sd, MakeUserData(UringOp::RECV, client_id));
+                    ++con->num_uring_requests;
+                } else {
+                    // Closed by the peer or an error, like a failing recv() in TcpSocket::DoRecv
+                    con->socket.Close(true);
+                }
+            }
+
+            this->Activate(*con);
+        } else if (op == UringOp::SEND && con != nullptr) {
+            --con->num_uring_requests;
+            con->uring_send_in_flight = false;
+
+            if (completion.result < 0) {
+                con->uring_send.ResetFrame();
+
+                if (!con->garbage) {
+                    LogError("server", "send() error: {}"_format(strerror(-completion.result)));
+                    con->socket.Close(true);
+                }
             } else {
-                session->Tick(dt);
+                con->uring_send.Advance(completion.result);
+
+                // Releases the packets
+                if (con->uring_send.IsFrameDone()) {
+                    con->uring_send.ResetFrame();
+                }
             }
+
+            this->Activate(*con);
         }
     }
 }
 
-void Server::NotifySent(ClientConnection &con) {
-    assert(static_cast<size_t>(con.id) < this->pollfds.size());
-    this->pollfds[con.id].events |= POLLOUT;
+// Only connections with traffic, queued packets or an ingame state are ticked, idle ones cost nothing
+void Server::TickConnections(f32 dt) {
+    std::swap(this->active_connections, this->ticking_connections);
+    this->active_connections.clear();
+
+    for (auto client_id : this->ticking_connections) {
+        if (auto con = this->TryGetConnection(client_id)) {
+            con->is_active = false;
+        }
+    }
+
+    for (auto client_id : this->ticking_connections) {
+        auto &con = this->clients[client_id];
+        if (con == nullptr) {
+            continue;
+        }
+
+        if (!con->garbage) {
+            con->Tick(dt);
+        }
+
+        if (con->garbage && con->num_uring_requests > 0) {
+            // The kernel may still write into the buffers of the connection, free it once everything finished
+            if (!con->uring_cancelled) {
+                this->uring.Cancel(MakeUserData(UringOp::RECV, client_id), MakeUserData(UringOp::CANCEL, client_id));
+                this->uring.Cancel(MakeUserData(UringOp::SEND, client_id), MakeUserData(UringOp::CANCEL, client_id));
+                con->uring_cancelled = true;
+            }
+
+            continue;
+        }
+
+        if (con->garbage) {
+            this->poller.Remove(con->socket.sd, client_id);
+            con.reset();
+            this->free_client_ids.emplace_back(client_id);
+            continue;
+        }
+
+        if (!con->writable && !con->uring) {
+            this->poller.WaitForOutgoing(con->socket.sd, client_id);
+        }
+
+        if (con->NeedsTick()) {
+            this->Activate(*con);
+        }
+    }
 }
 
-Optional<i32> Server::CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent) {
+void Server::Activate(ClientConnection &con) {
+    if (!con.is_active) {
+        con.is_active = true;
+        this->active_connections.emplace_back(con.id);
+    }
+}
+
+Optional<i32> Server::CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent, const SimSettings &sim_settings) {
     if (name.empty() || name.size() > 20) {
         LogWarning("server", "Cannot create session, invalid name");
         return std::nullopt;
@@ -180,7 +459,8 @@ Optional<i32> Server::CreateSession(StringView name, StringView password, i32 nu
         return std::nullopt;
     }
 
-    LogInfo("server", "Creating session {}, password: {}, number of players: {}"_format(name, password, num_players));
+    LogInfo("server", "Creating session {}, password: {}, number of players: {}, gravity: {}, integrator: {}, tick interval: {}"_format(
+        name, password, num_players, ToString(sim_settings.gravity_solver), ToString(sim_settings.integrator), sim_settings.tick_interval));
 
     i32 session_id = 0;
     auto free_found = false;
@@ -200,7 +480,7 @@ Optional<i32> Server::CreateSession(StringView name, StringView password, i32 nu
         this->sessions.emplace_back(std::make_unique<Session>(this));
     }
 
-    this->sessions[session_id]->Start(session_id, name, password, num_players, num_npcs, persistent);
+    this->sessions[session_id]->Start(session_id, name, password, num_players, num_npcs, persistent, sim_settings);
 
     return session_id;
 }
@@ -248,33 +528,31 @@ void Server::GetInfo(GetSessionInfoResponse &output) const {
     }
 }
 
-void Server::DoAccept() {
+bool Server::DoAccept() {
     sockaddr_in client_address;
     auto client_socket = net::AcceptNonBlockingSocket(this->sd, &client_address);
 
     if (client_socket == -1) {
-        if (net::IsEWouldBlock()) {
-            return;
+        if (!net::IsEWouldBlock()) {
+            LogWarning("server", "Failed to accept client: {}"_format(net::GetErrorString()));
         }
 
-        LogWarning("server", "Failed to accept client");
-        return;
+        return false;
     }
 
-    i32 client_id = 1;
-    auto free_found = false;
+    this->AddClient(client_socket, client_address);
+    return true;
+}
 
-    for (; client_id < static_cast<i32>(this->clients.size()); ++client_id) {
-        if (this->clients[client_id] == nullptr) {
-            free_found = true;
-            break;
-        }
-    }
+void Server::AddClient(net::SocketDescriptor client_socket, const sockaddr_in &client_address) {
+    i32 client_id;
 
-    if (!free_found) {
+    if (!this->free_client_ids.empty()) {
+        client_id = this->free_client_ids.back();
+        this->free_client_ids.pop_back();
+    } else {
         client_id = static_cast<i32>(this->clients.size());
         this->clients.emplace_back();
-        this->pollfds.emplace_back();
     }
 
     LogInfo("server", "Client connected: {}:{}"_format(inet_ntoa(client_address.sin_addr), client_address.sin_port));
@@ -284,9 +562,17 @@ void Server::DoAccept() {
     TcpSocket tcp_socket;
     tcp_socket.SetConnectedSocket(client_socket);
     con = std::make_unique<ClientConnection>(client_id, ToRvalue(tcp_socket));
-    con->Start();
 
-    this->pollfds[client_id] = {.fd = client_socket, .events = POLLIN };
+    if (this->uring.IsRunning()) {
+        con->uring = true;
+        con->num_uring_requests = 1;
+        this->uring.RecvMultishot(client_socket, MakeUserData(UringOp::RECV, client_id));
+    } else {
+        this->poller.Add(client_socket, client_id);
+    }
+
+    con->Start();
+    this->Activate(*con);
 }
 
 Server &GetServer() {
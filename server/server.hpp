@@ -6,20 +6,36 @@
 #include "common/net_msg.hpp"
 #include "common/socket.hpp"
 #include "server/client_connection.hpp"
+#include "common/worker_pool.hpp"
+#include "common/tick_stats.hpp"
+#include "common/poller.hpp"
+#include "common/uring.hpp"
 
 struct Server {
+    constexpr static size_t PHASE_POLL        = 0;
+    constexpr static size_t PHASE_CONNECTIONS = 1;
+    constexpr static size_t PHASE_SESSIONS    = 2;
+
     Server();
     ~Server();
     bool Start();
     void Quit();
     void MainLoop();
     void Tick();
-    void NotifySent(ClientConnection &con);
-    Optional<i32> CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent);
+    void TickSessions(f32 dt);
+    void PollEvents();
+    void SubmitSends();
+    void ReapCompletions();
+    void TickConnections(f32 dt);
+    void Activate(ClientConnection &con); // Ticks the connection in the next server tick
+    Optional<i32> CreateSession(StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent, const SimSettings &sim_settings = {});
     Session *TryGetSession(i32 id);
     ClientConnection *TryGetConnection(i32 id);
     void GetInfo(GetSessionInfoResponse &output) const;
-    void DoAccept();
+    void GetTickStats(TickStatsResponse &output) const;
+    void LogTickOverruns();
+    bool DoAccept(); // False once there is nobody left to accept
+    void AddClient(net::SocketDescriptor client_socket, const sockaddr_in &client_address);
 
     inline void	ProtoErr(ClientConnection &con) {
         con.Close(false, DisconnectReason::PROTO_ERR, "Protocol error");
@@ -27,10 +43,25 @@ struct Server {
 
     constexpr static i32 default_port = 1303;
     net::SocketDescriptor sd = -1;
-    Array<pollfd> pollfds;
+#ifdef LINUX
+    net::PollerBackend poller_backend = net::PollerBackend::EPOLL;
+#else
+    net::PollerBackend poller_backend = net::PollerBackend::POLL;
+#endif
+    net::Poller poller; // Ids are client ids, the listen socket is 0
+    Array<net::Poller::Event> poll_events;
+    net::Uring uring; // Instead of the poller if running
+    Array<net::Uring::Completion> completions;
     Array<UniquePtr<ClientConnection>> clients;
+    Array<i32> free_client_ids;
+    Array<i32> active_connections; // Client ids, only these are ticked
+    Array<i32> ticking_connections;
     Array<UniquePtr<Session>> sessions;
+    Array<Session *> sessions_to_tick;
+    WorkerPool worker_pool;
+    Optional<size_t> num_worker_threads; // Defaults to one per core
     bool quit_flag = false;
+    TickStats tick_stats;
 };
 
 Server &GetServer();
@@ -14,7 +14,7 @@ ServerGameState::ServerGameState(Session *session)
     this->command_callbacks[GameCommand::Type::MOVE_TANK] =
         [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
             auto &move_tank = static_cast<MoveTankCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
+            auto player_tank = state.GetCommandTank(context);
 
             if (player_tank != Entity{move_tank.entity}) {
                 return false;
@@ -29,7 +29,7 @@ ServerGameState::ServerGameState(Session *session)
     this->command_callbacks[GameCommand::Type::ROTATE_TURRET] =
         [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
             auto &rotate_turret = static_cast<RotateTurretCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
+            auto player_tank = state.GetCommandTank(context);
 
             if (player_tank != Entity{rotate_turret.entity}) {
                 return false;
@@ -47,7 +47,7 @@ ServerGameState::ServerGameState(Session *session)
     this->command_callbacks[GameCommand::Type::CHARGE] =
         [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
             auto &charge_command = static_cast<ChargeCommand &>(command);
-            auto player_tank = state.session->GetPlayer(*context.con).tank_id;
+            auto player_tank = state.GetCommandTank(context);
             if (player_tank != Entity{charge_command.entity}) {
                 return false;
             }
@@ -92,7 +92,7 @@ ServerGameState::ServerGameState(Session *session)
     this->command_callbacks[GameCommand::Type::SWITCH_WEAPON] =
         [](ServerGameState &state, const CommandContext &context, GameCommand &command) {
             auto &switch_weapon = static_cast<SwitchWeaponCommand &>(command);
-            auto &tank = state.entities.Get<CTank>(state.session->GetPlayer(*context.con).tank_id);
+            auto &tank = state.entities.Get<CTank>(state.GetCommandTank(context));
             tank.weapon_type = switch_weapon.weapon_type;
             return true;
         };
@@ -105,10 +105,17 @@ void ServerGameState::Serialize(Packet &packet) const {
     packet.WriteU8(this->background_color.a);
     packet.WriteF32(this->size.x);
     packet.WriteF32(this->size.y);
+    this->settings.Serialize(packet);
+    packet.WriteF32(this->time);
+    packet.WriteU32(this->tick);
     SerializeEntities(this->entities, packet);
 }
 
 bool ServerGameState::HandleCommand(const CommandContext &context, GameCommand &command) {
+    if (this->settings.deterministic) {
+        return this->BroadcastInput(context, command);
+    }
+
     auto it = this->command_callbacks.find(command.type);
 
     if (it == this->command_callbacks.end()) {
@@ -130,9 +137,66 @@ bool ServerGameState::HandleCommand(const CommandContext &context, GameCommand &
     return succeeded;
 }
 
+bool ServerGameState::BroadcastInput(const CommandContext &context, const GameCommand &command) {
+    auto player_tank = this->GetCommandTank(context);
+    auto entity = entt::to_integral(player_tank);
+
+    switch (command.type) {
+        case GameCommand::Type::MOVE_TANK:
+            entity = static_cast<const MoveTankCommand &>(command).entity;
+            break;
+
+        case GameCommand::Type::ROTATE_TURRET:
+            entity = static_cast<const RotateTurretCommand &>(command).entity;
+            break;
+
+        case GameCommand::Type::CHARGE:
+            entity = static_cast<const ChargeCommand &>(command).entity;
+            break;
+
+        case GameCommand::Type::SWITCH_WEAPON:
+            break;
+
+        default:
+            return false;
+    }
+
+    if (player_tank != Entity{entity}) {
+        return false;
+    }
+
+    Packet command_packet;
+    this->SerializeCommand(command, command_packet);
+
+    // Applied a few ticks in the future, so the input reaches the clients before they simulate that tick
+    InputCommandMessage message;
+    message.tick = this->tick + this->settings.input_delay_ticks;
+    message.tank = entt::to_integral(player_tank);
+    message.command.assign(command_packet.buffer.begin() + sizeof(Packet_Header), command_packet.buffer.end());
+
+    Packet packet;
+    message.Serialize(packet);
+    this->session->BroadcastPacket(ToRvalue(packet));
+
+    this->QueueInput(message.tick, player_tank, ToRvalue(command_packet.buffer));
+    return true;
+}
+
+// Inputs handled from now on are stamped with tick + input_delay_ticks or later, the earlier ticks are complete
+void ServerGameState::BroadcastInputsConfirmed() {
+    InputsConfirmedMessage message;
+    message.tick = this->tick + this->settings.input_delay_ticks;
+
+    Packet packet;
+    message.Serialize(packet);
+    this->session->BroadcastPacket(ToRvalue(packet));
+}
+
 void ServerGameState::Prepare() {
     LogInfo("server_game_state prepare", "creating player tanks");
 
+    this->settings.seed = std::uniform_int_distribution<u64>{}(this->rng);
+
     constexpr Vec2 planet_padding{300.0f, 300.0f};
     constexpr Vec2 planet_spacing{480.0f, 480.0f};
     constexpr Vec2i planet_grid_size{4, 4};
@@ -194,11 +258,22 @@ void ServerGameState::Prepare() {
         auto &health = this->entities.Get<CHealth>(npc_tank);
         health.value = 100.0f;
         health.max = 100.0f;
+        this->npc_controller.Add(npc_tank);
     }
 }
 
-void ServerGameState::DestroyEntity(Entity entity) {
-    if (this->entities.TryGet<CTank>(entity) != nullptr) {
+void ServerGameState::OnDestroyEntities(const Array<Entity> &destroyed) {
+    if (this->settings.deterministic) {
+        // The clients destroy them themselves
+        return;
+    }
+
+    auto tank_destroyed = std::any_of(destroyed.begin(), destroyed.end(),
+        [&](Entity entity) {
+            return this->entities.TryGet<CTank>(entity) != nullptr;
+        });
+
+    if (tank_destroyed) {
         PlaySfxCommand play_sfx;
         play_sfx.sfx = PlaySfxCommand::Sfx::TANK_EXPLOSION;
 
@@ -209,30 +284,69 @@ void ServerGameState::DestroyEntity(Entity entity) {
         this->session->BroadcastPacket(ToRvalue(packet));
     }
 
-    this->entities.Destroy(entity);
+    // The clients reject commands with more than MAX_TARGETS, a burst of expiring projectiles is split up
+    for (size_t first = 0; first < destroyed.size(); first += DestroyEntitiesCommand::MAX_TARGETS) {
+        auto last = std::min(destroyed.size(), first + DestroyEntitiesCommand::MAX_TARGETS);
 
-    DestroyEntityCommand destroy_entitiy_command;
-    destroy_entitiy_command.target = entt::to_integral(entity);
+        DestroyEntitiesCommand destroy_entities_command;
+        destroy_entities_command.targets.reserve(last - first);
 
-    GameCommandMessage message;
-    Packet packet;
-    message.Serialize(packet);
-    this->SerializeCommand(destroy_entitiy_command, packet);
-    this->session->BroadcastPacket(ToRvalue(packet));
+        for (auto i = first; i < last; ++i) {
+            destroy_entities_command.targets.emplace_back(entt::to_integral(destroyed[i]));
+        }
+
+        GameCommandMessage message;
+        Packet packet;
+        message.Serialize(packet);
+        this->SerializeCommand(destroy_entities_command, packet);
+        this->session->BroadcastPacket(ToRvalue(packet));
+    }
+}
+
+Entity ServerGameState::GetCommandTank(const CommandContext &context) const {
+    if (context.con == nullptr) {
+        return context.tank;
+    }
+
+    return this->session->GetPlayer(*context.con).tank_id;
+}
+
+// The shooter saw the other tanks half a round trip late. NPCs have no connection and see the present.
+u32 ServerGameState::GetRewindTicks(Entity tank) const {
+    if (this->settings.max_rewind_ticks == 0) {
+        return 0;
+    }
+
+    for (const auto &player : this->session->players) {
+        if (player.has_value() && player.value().tank_id == tank && player.value().con != nullptr) {
+            // The round trip time is in frames, a tick covers tick_interval of them
+            auto ticks = player.value().con->rtt_avg / 2.0f / static_cast<f32>(this->settings.tick_interval);
+            return std::min(static_cast<u32>(std::max(0.0f, std::round(ticks))), this->settings.max_rewind_ticks);
+        }
+    }
+
+    return 0;
 }
 
 bool ServerGameState::FireProjectile(Entity firing_tank) {
-    auto projectiles = this->Fire(firing_tank, false);
+    const auto &projectiles = this->Fire(firing_tank, false);
     if (projectiles.empty()) {
         //log_debug("projectile spawn", "no projectile");
         // Could not fire, maybe due to cooldown etc.
         return false;
     }
 
+    if (this->settings.deterministic) {
+        return true;
+    }
+
     //log_debug("projectile spawn", "spawn projectile");
     auto &tank = this->entities.Get<CTank>(firing_tank);
+    auto rewind_ticks = this->GetRewindTicks(firing_tank);
 
     for (const auto &projectile : projectiles) {
+        this->entities.Get<CProjectile>(projectile).rewind_ticks = rewind_ticks;
+
         // Send the spawn command
         SpawnProjectileCommand spawn_projectile_command;
         spawn_projectile_command.target = entt::to_integral(projectile);
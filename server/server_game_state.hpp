@@ -1,4 +1,5 @@
 #include "common/game_state.hpp"
+#include "server/npc_controller.hpp"
 
 struct Session;
 
@@ -9,10 +10,15 @@ struct ServerGameState : public GameState {
     ServerGameState(Session *session);
     void Serialize(Packet &packet) const;
     bool HandleCommand(const CommandContext &context, GameCommand &command) final;
+    bool BroadcastInput(const CommandContext &context, const GameCommand &command);
+    void BroadcastInputsConfirmed();
     void Prepare();
-    void DestroyEntity(Entity entity) final;
-    bool FireProjectile(Entity firing_tank);
+    void OnDestroyEntities(const Array<Entity> &destroyed) final;
+    bool FireProjectile(Entity firing_tank) final;
+    u32 GetRewindTicks(Entity tank) const;
+    Entity GetCommandTank(const CommandContext &context) const;
 
     Command_Callback_Map command_callbacks;
     Session *session = nullptr;
+    NpcController npc_controller;
 };
@@ -5,14 +5,16 @@
 #include "server/client_connection_state.hpp"
 #include "common/log.hpp"
 #include "common/player_info.hpp"
+#include "common/frame_timer.hpp"
 
 Session::Session(Server *server)
     : server(server) {
+    this->tick_stats.SetPhases({"npcs", "simulation", "broadcast"});
 }
 
 Session::~Session() = default;
 
-void Session::Start(i32 id, StringView name, StringView pw, i32 nplayers, i32 num_npcs, bool persistent) {
+void Session::Start(i32 id, StringView name, StringView pw, i32 nplayers, i32 num_npcs, bool persistent, const SimSettings &sim_settings) {
     assert(nplayers >= 1);
     this->id = id;
     this->name = name;
@@ -20,6 +22,7 @@ void Session::Start(i32 id, StringView name, StringView pw, i32 nplayers, i32 nu
     this->num_players = nplayers;
     this->num_npcs = num_npcs;
     this->is_persistent = persistent;
+    this->sim_settings = sim_settings;
     this->state = SessionState::LOBBY;
 }
 
@@ -167,7 +170,10 @@ bool Session::SetPlayerReady(ClientConnection &con) {
 
 void Session::StartGame() {
     this->game_state = std::make_unique<ServerGameState>(this);
+    this->game_state->settings = this->sim_settings;
     this->game_state->Prepare();
+    this->replication = {};
+    this->snapshot_pending = false;
 
     for (auto& player : this->players) {
         if (!player.has_value()) {
@@ -188,14 +194,19 @@ void Session::StartGame() {
     message.Serialize(level_packet);
     this->game_state->Serialize(level_packet);
     level_packet.WriteHeader();
+    auto level_buffer = std::make_shared<const Array<char>>(ToRvalue(level_packet.buffer));
 
     for (auto &player : this->players) {
         if (player.has_value()) {
             auto &con = player.value().con;
-            con->SendPacketCopy(level_packet);
+            con->SendSharedPacket(level_buffer);
             con->SetNextState(client_connection_states::MakeIngame(con));
         }
     }
+
+    if (this->game_state->settings.deterministic) {
+        this->game_state->BroadcastInputsConfirmed();
+    }
 }
 
 SessionPlayer &Session::GetPlayer(ClientConnection &con) {
@@ -208,22 +219,150 @@ SessionPlayer &Session::GetPlayer(ClientConnection &con) {
     return player.value();
 }
 
-void Session::Tick(f32 dt) {
+void Session::Tick(f32 dt, WorkerPool *worker_pool) {
     if (this->state != SessionState::INGAME || this->game_state == nullptr) {
         return;
     }
 
-    this->game_state->Tick(dt);
+    // Lockstep clients tick once per frame, their simulation rate has to match
+    const auto &settings = this->game_state->settings;
+    auto tick_interval = settings.deterministic ? 1 : settings.tick_interval;
+
+    if (++this->frames_since_tick < tick_interval) {
+        return;
+    }
+
+    this->frames_since_tick = 0;
+    this->tick_stats.BeginTick();
+    PhaseTimer timer;
+
+    this->game_state->worker_pool = worker_pool;
+    this->game_state->npc_controller.Tick(*this->game_state);
+    this->tick_stats.Record(PHASE_NPCS, timer.Lap());
+
+    this->game_state->Tick(dt * static_cast<f32>(tick_interval));
+
+    // Lockstep clients simulate everything themselves, they only have to know when a tick has all its inputs
+    if (settings.deterministic) {
+        this->game_state->BroadcastInputsConfirmed();
+    } else if (this->game_state->tick % ReplicationHistory::SNAPSHOT_INTERVAL == 0) {
+        this->replication.Push(this->game_state->tick).Capture(this->game_state->entities);
+        this->snapshot_pending = true;
+    }
+
+    this->tick_stats.Record(PHASE_SIMULATION, timer.Lap());
+
+#if defined(DEVELOPMENT) && DEVELOPMENT
+    if (this->game_state->tick % 600 == 0) {
+        LogInfo("session", "System timings of session {}:\n{}"_format(this->id, this->game_state->scheduler.FormatTimings()));
+
+        if (this->game_state->settings.gravity_solver == GravitySolver::FIELD) {
+            const auto &field = this->game_state->gravity_field;
+            LogInfo("session", "Gravity field of session {}: error bound {} (limit {}), cell size {}, {} builds"_format(
+                this->id, field.GetErrorBound(), this->game_state->settings.field_max_error, field.cell_size, field.num_builds));
+        }
+
+        LogInfo("session", "Tick timings of {}"_format(FormatTickStats(this->tick_stats.GetSummary("session {}"_format(this->id)))));
+
+        const auto &npc_controller = this->game_state->npc_controller;
+        if (!npc_controller.npcs.empty()) {
+            LogInfo("session", "NPCs of session {}: {} searches, {} candidates, {:.4f} ms per candidate"_format(
+                this->id, npc_controller.num_searches, npc_controller.num_candidates, npc_controller.ms_per_candidate));
+        }
+    }
+#endif
 }
 
 void Session::BroadcastPacket(Packet &&packet) {
     packet.WriteHeader();
 
+    // Serialized once, every recipient only references it
+    auto buffer = std::make_shared<const Array<char>>(ToRvalue(packet.buffer));
+
+    if (this->defer_broadcasts) {
+        this->outbox.emplace_back(ToRvalue(buffer));
+        return;
+    }
+
     for (const auto &player : this->players) {
         if (player.has_value()) {
-            player.value().con->SendPacketCopy(packet);
+            player.value().con->SendSharedPacket(buffer);
+        }
+    }
+}
+
+void Session::FlushOutbox() {
+    assert(!this->defer_broadcasts);
+    PhaseTimer timer;
+
+    for (const auto &buffer : this->outbox) {
+        for (const auto &player : this->players) {
+            if (player.has_value()) {
+                player.value().con->SendSharedPacket(buffer);
+            }
         }
     }
+
+    this->outbox.clear();
+
+    if (this->snapshot_pending) {
+        this->SendSnapshot();
+        this->snapshot_pending = false;
+    }
+
+    // Sessions run concurrently, each of them has the whole tick
+    this->tick_stats.Record(PHASE_BROADCAST, timer.Lap());
+    this->tick_stats.EndTick(chrono::duration<f32, std::milli>(GetFrameTimer().GetTickLength()).count());
+}
+
+void Session::SendSnapshot() {
+    const auto &snapshot = this->replication.GetLatest();
+    this->snapshot_deltas.clear();
+
+    for (const auto &player : this->players) {
+        if (!player.has_value()) {
+            continue;
+        }
+
+        auto baseline = this->replication.Get(player.value().acked_snapshot);
+        auto baseline_id = baseline != nullptr ? baseline->id : 0;
+
+        auto it = std::find_if(this->snapshot_deltas.begin(), this->snapshot_deltas.end(),
+            [&](const auto &delta) {
+                return delta.first == baseline_id;
+            });
+
+        if (it == this->snapshot_deltas.end()) {
+            EntitySnapshotMessage message;
+            message.id = snapshot.id;
+            message.baseline = baseline_id;
+            message.tick = snapshot.tick;
+
+            Packet packet;
+            message.Serialize(packet);
+            WriteSnapshotDelta(snapshot, baseline, packet);
+            packet.WriteHeader();
+
+            this->snapshot_deltas.emplace_back(baseline_id, std::make_shared<const Array<char>>(ToRvalue(packet.buffer)));
+            it = this->snapshot_deltas.end() - 1;
+        }
+
+        player.value().con->SendSharedPacket(it->second);
+    }
+
+    this->snapshot_deltas.clear();
+}
+
+bool Session::AckSnapshot(ClientConnection &con, u32 id) {
+    auto &player = this->GetPlayer(con);
+
+    // Acks arrive in order, anything else was never sent
+    if (id <= player.acked_snapshot || id > this->replication.latest_id) {
+        return false;
+    }
+
+    player.acked_snapshot = id;
+    return true;
 }
 
 i32 Session::GetNumberOfConnectedPlayers(bool only_ready) const {
@@ -4,6 +4,9 @@
 #include "common/session_info.hpp"
 #include "common/player_info.hpp"
 #include "common/game_state.hpp"
+#include "common/tick_stats.hpp"
+#include "common/socket.hpp"
+#include "common/replication.hpp"
 
 struct Server;
 struct Packet;
@@ -26,6 +29,7 @@ struct SessionPlayer {
     ClientConnection *con;
     bool ready = false;
     Entity tank_id = entt::null;
+    u32 acked_snapshot = 0; // Baseline of the entity snapshots to this player, 0 for none
     String name;
 #if defined(DEVELOPMENT) && DEVELOPMENT
     i32 name_collision_index = 0;
@@ -33,17 +37,24 @@ struct SessionPlayer {
 };
 
 struct Session {
+    constexpr static size_t PHASE_NPCS       = 0;
+    constexpr static size_t PHASE_SIMULATION = 1;
+    constexpr static size_t PHASE_BROADCAST  = 2;
+
     explicit Session(Server *server);
     ~Session();
-    void Start(i32 id, StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent);
+    void Start(i32 id, StringView name, StringView password, i32 num_players, i32 num_npcs, bool persistent, const SimSettings &sim_settings = {});
     JoinSessionResult Join(ClientConnection &con, StringView player_name, StringView password);
     bool Remove(ClientConnection &con);
     bool HasPlayer(const ClientConnection &con) const;
     bool SetPlayerReady(ClientConnection &con);
     void StartGame();
     SessionPlayer &GetPlayer(ClientConnection &con);
-    void Tick(f32 dt);
+    void Tick(f32 dt, WorkerPool *worker_pool = nullptr);
     void BroadcastPacket(Packet &&packet);
+    void FlushOutbox();
+    void SendSnapshot();
+    bool AckSnapshot(ClientConnection &con, u32 id);
     i32 GetNumberOfConnectedPlayers(bool only_ready = false) const;
     PlayerInfo GetPlayerInfo(const SessionPlayer &player) const;
 
@@ -64,4 +75,18 @@ struct Session {
     i32 num_npcs = 0;
     Array<Optional<SessionPlayer>> players;
     bool is_persistent = false;
+    SimSettings sim_settings;
+    u32 frames_since_tick = 0;
+    TickStats tick_stats; // A tick ends when its broadcasts are flushed
+
+    // While the sessions are ticked on the worker pool, broadcasts are only collected here.
+    // The main thread owns the connections and sends them after all sessions are done.
+    bool defer_broadcasts = false;
+    Array<PacketBuffer> outbox;
+
+    // Entity state goes out as a delta per player against the snapshot the player acknowledged last.
+    // Captured in Tick, sent with the outbox so that the commands creating the entities arrive first.
+    ReplicationHistory replication;
+    bool snapshot_pending = false;
+    Array<std::pair<u32, PacketBuffer>> snapshot_deltas; // By baseline, players that acknowledged the same snapshot share one
 };
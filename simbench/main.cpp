@@ -0,0 +1,993 @@
+#include "common/game_state.hpp"
+#include "common/worker_pool.hpp"
+#include "common/log.hpp"
+#include "common/trajectory_predictor.hpp"
+#include "common/replication.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+#ifdef LINUX
+#include "common/poller.hpp"
+#include "common/uring.hpp"
+#include <sys/resource.h>
+#endif
+
+// Headless GameState::Tick benchmark, no SDL, no sockets. Prints JSON with the per-system and total
+// tick latencies so simulation regressions can be tracked per commit.
+
+struct BenchGameState : public GameState {
+    bool HandleCommand(const CommandContext &context, GameCommand &command) final {
+        return false;
+    }
+
+    void OnDestroyEntities(const Array<Entity> &destroyed) final {
+    }
+
+    bool FireProjectile(Entity firing_tank) final {
+        const auto &projectiles = this->Fire(firing_tank, false);
+        this->num_spawned_projectiles += projectiles.size();
+        return !projectiles.empty();
+    }
+
+    size_t num_spawned_projectiles = 0;
+};
+
+struct BenchConfig {
+    size_t num_planets = 16;
+    size_t num_tanks = 8;
+    size_t num_projectiles = 1000;
+    size_t num_ticks = 1000;
+    size_t num_warmup_ticks = 50;
+    size_t num_threads = 1;
+    u32 seed = 1;
+    bool fire = false;
+    SimSettings settings;
+};
+
+struct Percentiles {
+    f64 p50 = 0.0;
+    f64 p99 = 0.0;
+    f64 mean = 0.0;
+    f64 max = 0.0;
+};
+
+static Percentiles ComputePercentiles(Array<f64> samples) {
+    Percentiles res;
+
+    if (samples.empty()) {
+        return res;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    res.p50 = samples[samples.size() / 2];
+    res.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    res.max = samples.back();
+
+    for (auto sample : samples) {
+        res.mean += sample;
+    }
+
+    res.mean /= static_cast<f64>(samples.size());
+    return res;
+}
+
+static String ToJson(const Percentiles &percentiles) {
+    return R"({{"p50": {:.4f}, "p99": {:.4f}, "mean": {:.4f}, "max": {:.4f}}})"_format(
+        percentiles.p50, percentiles.p99, percentiles.mean, percentiles.max);
+}
+
+static void SpawnProjectiles(BenchGameState &state, size_t count, std::mt19937 &rng) {
+    std::uniform_real_distribution dist_x{0.0f, state.size.x};
+    std::uniform_real_distribution dist_y{0.0f, state.size.y};
+    std::uniform_real_distribution dist_velocity{-5.0f, 5.0f};
+
+    for (size_t i = 0; i < count; ++i) {
+        auto projectile = CreateEntity(state.entities, EntityPrefabId::PROJECTILE);
+        auto position = Vec2{dist_x(rng), dist_y(rng)};
+        auto velocity = Vec2{dist_velocity(rng), dist_velocity(rng)};
+        state.entities.Get<CPosition>(projectile).value = position;
+        state.entities.Get<CVelocity>(projectile).value = velocity;
+        state.entities.Get<CMass>(projectile).value = 5.0f;
+        state.entities.Get<CTimeToLiveBeforeExplosion>(projectile).value = 1e9f;
+        state.entities.Get<CProjectile>(projectile).firing_entity = entt::null;
+
+        if (state.settings.deterministic) {
+            state.entities.Add<CFixedBody>(projectile, FixedVec2::FromVec2(position), FixedVec2::FromVec2(velocity));
+        }
+    }
+}
+
+static void CreateScene(BenchGameState &state, const BenchConfig &config, std::mt19937 &rng) {
+    constexpr Vec2 planet_padding{300.0f, 300.0f};
+    constexpr Vec2 planet_spacing{480.0f, 480.0f};
+
+    std::uniform_real_distribution dist_displacement{-170.0f, 170.0f};
+    std::uniform_real_distribution dist_mass{17.0f, 32.0f};
+    std::uniform_real_distribution dist_radius{70.0f, 120.0f};
+    std::uniform_real_distribution dist_planet_position{0.0f, 360.0f};
+
+    state.settings = config.settings;
+    state.settings.seed = config.seed;
+
+    auto grid_size = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::sqrt(static_cast<f64>(config.num_planets)))));
+    state.size = 2.0f * planet_padding + Vec2{static_cast<f32>(grid_size)} * planet_spacing;
+
+    Array<Entity> planets;
+
+    for (size_t i = 0; i < config.num_planets; ++i) {
+        auto planet = CreateEntity(state.entities, EntityPrefabId::PLANET);
+        planets.emplace_back(planet);
+
+        auto displacement = Vec2{dist_displacement(rng), dist_displacement(rng)};
+        auto position = planet_padding + Vec2{i % grid_size, i / grid_size} * planet_spacing + displacement;
+        state.entities.Get<CPosition>(planet).value = position;
+        state.entities.Get<CMass>(planet).value = dist_mass(rng);
+        state.entities.Get<CPlanet>(planet).radius = dist_radius(rng);
+        state.entities.Get<CPlanet>(planet).initial_position = position;
+    }
+
+    for (size_t i = 0; i < config.num_tanks && !planets.empty(); ++i) {
+        auto tank = CreateEntity(state.entities, EntityPrefabId::TANK);
+        state.entities.Get<CTank>(tank).planet_id = planets[i % planets.size()];
+        state.entities.Get<CPlanetPosition>(tank).value = dist_planet_position(rng);
+        auto &health = state.entities.Get<CHealth>(tank);
+        health.value = 1e9f;
+        health.max = 1e9f;
+
+        if (config.fire) {
+            state.entities.Get<CTank>(tank).weapon_type = Weapon::Type::MACHINEGUN;
+            state.entities.Add<CCharging>(tank);
+        }
+    }
+
+    SpawnProjectiles(state, config.num_projectiles, rng);
+}
+
+static String RunBenchmark(const BenchConfig &config, WorkerPool &worker_pool) {
+    std::mt19937 rng{config.seed};
+    BenchGameState state;
+    CreateScene(state, config, rng);
+    state.worker_pool = config.num_threads > 1 ? &worker_pool : nullptr;
+
+    // One simulation tick covers tick_interval server frames, like in Session::Tick
+    auto dt = static_cast<f32>(config.settings.deterministic ? 1 : config.settings.tick_interval);
+
+    auto num_systems = state.scheduler.systems.size();
+    Array<f64> total_samples;
+    Array<Array<f64>> system_samples(num_systems);
+    size_t num_hitscan_shots = 0;
+
+    for (size_t i = 0; i < config.num_warmup_ticks + config.num_ticks; ++i) {
+        auto start = chrono::steady_clock::now();
+        state.Tick(dt);
+        auto ms = chrono::duration<f64, std::milli>(chrono::steady_clock::now() - start).count();
+        num_hitscan_shots += state.hitscan_shots.size();
+
+        if (i >= config.num_warmup_ticks) {
+            total_samples.emplace_back(ms);
+
+            for (size_t system = 0; system < num_systems; ++system) {
+                system_samples[system].emplace_back(state.scheduler.timings[system].last_ms);
+            }
+        }
+
+        // Keep the load constant, projectiles get destroyed by planets and tanks
+        auto num_projectiles = state.entities.impl.size<CProjectile>();
+        if (!config.fire && num_projectiles < config.num_projectiles) {
+            SpawnProjectiles(state, config.num_projectiles - num_projectiles, rng);
+        }
+    }
+
+    String systems;
+
+    for (size_t system = 0; system < num_systems; ++system) {
+        systems += R"({}    "{}": {})"_format(
+            system == 0 ? "" : ",\n",
+            state.scheduler.systems[system].name,
+            ToJson(ComputePercentiles(system_samples[system])));
+    }
+
+    return R"({{
+  "config": {{"planets": {}, "tanks": {}, "projectiles": {}, "ticks": {}, "threads": {}, "gravity": "{}", "simd": {}, "deterministic": {}, "fire": {}, "integrator": "{}", "substeps": {}, "tick_interval": {}, "hitscan": {}}},
+  "fired": {{"projectiles": {}, "hitscan_rounds": {}}},
+  "total_ms": {},
+  "systems_ms": {{
+{}
+  }}
+}})"_format(
+        config.num_planets,
+        config.num_tanks,
+        config.num_projectiles,
+        config.num_ticks,
+        config.num_threads,
+        ToString(config.settings.gravity_solver),
+        config.settings.simd_kernel,
+        config.settings.deterministic,
+        config.fire,
+        ToString(config.settings.integrator),
+        config.settings.max_substeps,
+        config.settings.tick_interval,
+        config.settings.hitscan_machinegun,
+        state.num_spawned_projectiles,
+        num_hitscan_shots,
+        ToJson(ComputePercentiles(total_samples)),
+        systems);
+}
+
+// Speed and accuracy of the gravity solvers against the exact pairwise sum, after one tick
+static String RunGravityReport(const BenchConfig &base_config) {
+    constexpr size_t num_samples = 1000;
+
+    struct Variant {
+        StringView name;
+        GravitySolver solver;
+        bool simd_kernel;
+    };
+
+    constexpr Variant variants[] = {
+        {"exact",        GravitySolver::EXACT,      false},
+        {"exact-simd",   GravitySolver::EXACT,      true},
+        {"barnes-hut",   GravitySolver::BARNES_HUT, false},
+        {"field",        GravitySolver::FIELD,      false},
+    };
+
+    String res;
+
+    for (size_t num_bodies : {1000, 10000, 50000}) {
+        Array<Vec2> reference;
+        Array<Vec2> initial;
+        String solvers;
+
+        for (const auto &variant : variants) {
+            auto config = base_config;
+            config.num_tanks = 0;
+            config.num_projectiles = num_bodies;
+            config.settings.gravity_solver = variant.solver;
+            config.settings.simd_kernel = variant.simd_kernel;
+            config.settings.deterministic = false;
+
+            std::mt19937 rng{config.seed};
+            BenchGameState state;
+            CreateScene(state, config, rng);
+
+            Array<Entity> sampled;
+            state.entities.View<CProjectile>().each(
+                [&](Entity entity, CProjectile &projectile) {
+                    if (sampled.size() < num_samples) {
+                        sampled.emplace_back(entity);
+                    }
+                });
+
+            Array<Vec2> before;
+            for (auto entity : sampled) {
+                before.emplace_back(state.entities.Get<CVelocity>(entity).value);
+            }
+
+            state.Tick(1.0f);
+
+            size_t gravity_system = 0;
+            while (state.scheduler.systems[gravity_system].name != "gravity") {
+                ++gravity_system;
+            }
+
+            Array<Vec2> delta;
+            for (size_t i = 0; i < sampled.size(); ++i) {
+                // Collisions may have removed some of them, they keep their old velocity in the comparison
+                auto velocity = state.entities.IsValid(sampled[i]) ? state.entities.Get<CVelocity>(sampled[i]).value : before[i];
+                delta.emplace_back(velocity - before[i]);
+            }
+
+            if (reference.empty()) {
+                reference = delta;
+            }
+
+            f64 error_sum = 0.0;
+            f64 reference_sum = 0.0;
+
+            for (size_t i = 0; i < delta.size(); ++i) {
+                auto error = Vec2{delta[i] - reference[i]};
+                error_sum += glm::dot(error, error);
+                reference_sum += glm::dot(reference[i], reference[i]);
+            }
+
+            // The field reports its own bound against the exact planet sum, the relative error above also contains the
+            // dropped projectile-projectile attraction
+            auto field_error_bound = variant.solver == GravitySolver::FIELD ? state.gravity_field.GetErrorBound() : 0.0f;
+
+            solvers += R"({}      {{"solver": "{}", "gravity_ms": {:.4f}, "relative_error": {:.6g}, "field_error_bound": {:.6g}}})"_format(
+                solvers.empty() ? "" : ",\n",
+                variant.name,
+                state.scheduler.timings[gravity_system].last_ms,
+                reference_sum > 0.0 ? std::sqrt(error_sum / reference_sum) : 0.0,
+                field_error_bound);
+        }
+
+        res += R"({}    {{"bodies": {}, "solvers": [
+{}
+    ]}})"_format(res.empty() ? "" : ",\n", num_bodies, solvers);
+    }
+
+    return R"({{
+  "gravity_report": [
+{}
+  ]
+}})"_format(res);
+}
+
+// Trajectory drift of the integrators at lower tick rates. Projectiles orbit a single planet for the same
+// simulated time, the reference is the leapfrog at a sixteenth of a server frame.
+static String RunTrajectoryReport(const BenchConfig &base_config) {
+    constexpr size_t num_frames = 600;
+    constexpr u32 reference_steps_per_frame = 16;
+    constexpr size_t max_projectiles = 200; // The reference runs 16 times the ticks with pairwise gravity
+
+    struct Variant {
+        StringView name;
+        Integrator integrator;
+        u32 max_substeps;
+        u32 tick_interval;
+    };
+
+    constexpr Variant variants[] = {
+        {"euler-60hz",             Integrator::EULER,    1, 1},
+        {"euler-30hz",             Integrator::EULER,    1, 2},
+        {"euler-20hz",             Integrator::EULER,    1, 3},
+        {"leapfrog-30hz",          Integrator::LEAPFROG, 1, 2},
+        {"leapfrog-20hz",          Integrator::LEAPFROG, 1, 3},
+        {"leapfrog-substeps-30hz", Integrator::LEAPFROG, 4, 2},
+        {"leapfrog-substeps-20hz", Integrator::LEAPFROG, 4, 3},
+    };
+
+    auto simulate = [&](const SimSettings &settings, f32 dt, size_t num_ticks, f64 &tick_ms) {
+        auto config = base_config;
+        config.num_planets = 1;
+        config.num_tanks = 0;
+        config.num_projectiles = 0;
+        config.settings = settings;
+        // Test particles, with the pairwise solvers the projectiles pull each other into the planet within a few frames
+        config.settings.gravity_solver = GravitySolver::FIELD;
+
+        std::mt19937 rng{config.seed};
+        BenchGameState state;
+        CreateScene(state, config, rng);
+
+        // Near circular orbits between two and four planet radii, the force is linear in the distance
+        Entity planet = entt::null;
+        state.entities.View<CPlanet>().each([&](Entity entity, CPlanet &) { planet = entity; });
+
+        auto planet_position = state.entities.Get<CPosition>(planet).value;
+        auto planet_radius = state.entities.Get<CPlanet>(planet).radius;
+        auto planet_mass = state.entities.Get<CMass>(planet).value;
+        constexpr f32 projectile_mass = 5.0f;
+        auto angular_velocity = std::sqrt(gravitational_constant * projectile_mass * planet_mass);
+
+        std::uniform_real_distribution dist_radius{2.0f * planet_radius, 4.0f * planet_radius};
+        std::uniform_real_distribution dist_angle{0.0f, glm::two_pi<f32>()};
+        std::uniform_real_distribution dist_speed{0.9f, 1.1f};
+
+        Array<Entity> projectiles;
+
+        for (size_t i = 0; i < std::min(base_config.num_projectiles, max_projectiles); ++i) {
+            auto offset = glm::rotate(Vec2{dist_radius(rng), 0.0f}, dist_angle(rng));
+            auto projectile = CreateEntity(state.entities, EntityPrefabId::PROJECTILE);
+            state.entities.Get<CPosition>(projectile).value = planet_position + offset;
+            state.entities.Get<CVelocity>(projectile).value = Vec2{-offset.y, offset.x} * angular_velocity * dist_speed(rng);
+            state.entities.Get<CMass>(projectile).value = projectile_mass;
+            state.entities.Get<CTimeToLiveBeforeExplosion>(projectile).value = 1e9f;
+            state.entities.Get<CProjectile>(projectile).firing_entity = entt::null;
+            projectiles.emplace_back(projectile);
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < num_ticks; ++i) {
+            state.Tick(dt);
+        }
+        tick_ms = chrono::duration<f64, std::milli>(chrono::steady_clock::now() - start).count() / static_cast<f64>(num_ticks);
+
+        Array<Optional<Vec2>> positions;
+        for (auto projectile : projectiles) {
+            if (state.entities.IsValid(projectile)) {
+                positions.emplace_back(state.entities.Get<CPosition>(projectile).value);
+            } else {
+                positions.emplace_back(std::nullopt);
+            }
+        }
+
+        return positions;
+    };
+
+    SimSettings reference_settings = base_config.settings;
+    reference_settings.deterministic = false;
+    reference_settings.integrator = Integrator::LEAPFROG;
+    reference_settings.max_substeps = 1;
+
+    f64 reference_tick_ms = 0.0;
+    auto reference = simulate(
+        reference_settings, 1.0f / reference_steps_per_frame, num_frames * reference_steps_per_frame, reference_tick_ms);
+
+    String res;
+
+    for (const auto &variant : variants) {
+        auto settings = reference_settings;
+        settings.integrator = variant.integrator;
+        settings.max_substeps = variant.max_substeps;
+        settings.tick_interval = variant.tick_interval;
+
+        f64 tick_ms = 0.0;
+        auto positions = simulate(settings, static_cast<f32>(variant.tick_interval), num_frames / variant.tick_interval, tick_ms);
+
+        f64 max_error = 0.0;
+        f64 error_sum = 0.0;
+        size_t num_compared = 0;
+
+        for (size_t i = 0; i < positions.size(); ++i) {
+            if (positions[i].has_value() && reference[i].has_value()) {
+                auto error = static_cast<f64>(glm::distance(positions[i].value(), reference[i].value()));
+                max_error = std::max(max_error, error);
+                error_sum += error;
+                ++num_compared;
+            }
+        }
+
+        // CPU per simulated second, the ticks of the lower rates cover more frames each
+        auto ms_per_second = tick_ms * 60.0 / variant.tick_interval;
+
+        res += R"({}    {{"variant": "{}", "mean_error": {:.4f}, "max_error": {:.4f}, "compared": {}, "tick_ms": {:.4f}, "ms_per_second": {:.4f}}})"_format(
+            res.empty() ? "" : ",\n",
+            variant.name,
+            num_compared > 0 ? error_sum / static_cast<f64>(num_compared) : 0.0,
+            max_error,
+            num_compared,
+            tick_ms,
+            ms_per_second);
+    }
+
+    return R"({{
+  "trajectory_report": [
+{}
+  ]
+}})"_format(res);
+}
+
+// Cost of one aim guide path per weapon, the capture is included since the client does it every frame
+static String RunPredictorReport(const BenchConfig &config) {
+    constexpr size_t num_runs = 1000;
+
+    std::mt19937 rng{config.seed};
+    BenchGameState state;
+    CreateScene(state, config, rng);
+
+    // Straight up from the first tank, the middle of the world may well be inside of a planet
+    Entity tank = entt::null;
+    state.entities.View<CTank>().each([&](Entity entity, CTank &) { tank = entity; });
+
+    if (tank == entt::null) {
+        return R"({"predictor_report": []})";
+    }
+
+    auto position = state.GetTankWorldPosition(tank);
+    auto direction = glm::normalize(state.ComputeTankOffset(tank));
+
+    TrajectoryPredictor predictor;
+    Array<Vec2> path;
+    String res;
+
+    for (size_t weapon_index = 0; weapon_index < static_cast<size_t>(Weapon::Type::COUNT); ++weapon_index) {
+        const auto &weapon = g_weapons[weapon_index];
+        auto velocity = direction * weapon.speed;
+        auto hit = false;
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < num_runs; ++i) {
+            path.clear();
+            predictor.Capture(state);
+            hit = predictor.Predict(position, velocity, weapon.projectile_mass, CProjectile{}.radius, weapon.projectile_ttl, path);
+        }
+        auto us = chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count() / num_runs;
+
+        res += R"({}    {{"weapon": "{}", "points": {}, "hit_planet": {}, "predict_us": {:.3f}}})"_format(
+            res.empty() ? "" : ",\n", weapon.name, path.size(), hit, us);
+    }
+
+    return R"({{
+  "predictor_report": [
+{}
+  ]
+}})"_format(res);
+}
+
+static bool IsSameSnapshot(const ReplicationSnapshot &a, const ReplicationSnapshot &b) {
+    return std::equal(a.entities.begin(), a.entities.end(), b.entities.begin(), b.entities.end(),
+        [](const ReplicatedEntity &x, const ReplicatedEntity &y) {
+            return x.entity == y.entity && x.fields == y.fields && x.values == y.values;
+        });
+}
+
+// A fork restored from a snapshot has to replay the same ticks. The machineguns draw their spread from the rng and
+// the field solver only rebuilds its grid now and then, so both have to come back with the entities.
+static bool CheckSnapshotRestore(const BenchConfig &base_config) {
+    constexpr u32 num_ticks = 60;
+
+    auto config = base_config;
+    config.num_projectiles = std::min<size_t>(config.num_projectiles, 100);
+    config.fire = true;
+    config.settings.gravity_solver = GravitySolver::FIELD;
+
+    std::mt19937 rng{config.seed};
+    BenchGameState state;
+    CreateScene(state, config, rng);
+
+    for (u32 i = 0; i < num_ticks; ++i) {
+        state.Tick(1.0f);
+    }
+
+    GameStateSnapshot snapshot;
+    state.CaptureSnapshot(snapshot);
+
+    auto run = [&](ReplicationSnapshot &output) {
+        for (u32 i = 0; i < num_ticks; ++i) {
+            state.Tick(1.0f);
+        }
+
+        output.Capture(state.entities);
+    };
+
+    ReplicationSnapshot original;
+    ReplicationSnapshot replayed;
+    run(original);
+    state.RestoreSnapshot(snapshot);
+    run(replayed);
+
+    return IsSameSnapshot(original, replayed);
+}
+
+// Cost of forking the world: blob capture, restore into a live state and the registry to registry clone
+static String RunSnapshotReport(const BenchConfig &config) {
+    constexpr size_t num_runs = 1000;
+
+    std::mt19937 rng{config.seed};
+    BenchGameState state;
+    CreateScene(state, config, rng);
+
+    auto measure_us = [&](auto &&f) {
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < num_runs; ++i) {
+            f();
+        }
+        return chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count() / num_runs;
+    };
+
+    GameStateSnapshot snapshot;
+    BenchGameState fork;
+
+    auto capture_us = measure_us([&] { state.CaptureSnapshot(snapshot); });
+    auto restore_us = measure_us([&] { fork.RestoreSnapshot(snapshot); });
+    auto clone_us = measure_us([&] { state.Clone(fork); });
+
+    return R"({{
+  "snapshot_report": {{"entities": {}, "bytes": {}, "capture_us": {:.3f}, "restore_us": {:.3f}, "clone_us": {:.3f}}}
+}})"_format(state.entities.impl.alive(), snapshot.entities.GetByteSize(), capture_us, restore_us, clone_us);
+}
+
+// A field that changes and changes back before the client acknowledged the change has to arrive as well, and an
+// entity that is gone has to leave the rebuilt snapshot. The client applied S2 but the server only knows about the
+// ack of S1, so S3 is a delta against S1 in which the reverted fields are unchanged.
+static bool CheckReplication() {
+    BenchGameState server;
+    BenchGameState client;
+    ReplicationHistory server_history;
+    ReplicationHistory client_history;
+
+    auto tank = CreateEntity(server.entities, EntityPrefabId::TANK);
+    auto projectile = CreateEntity(server.entities, EntityPrefabId::PROJECTILE);
+    CreateEntity(client.entities, EntityPrefabId::TANK, tank);
+    CreateEntity(client.entities, EntityPrefabId::PROJECTILE, projectile);
+
+    auto send = [&](const ReplicationSnapshot *baseline) {
+        const auto &snapshot = server_history.GetLatest();
+        Packet packet;
+        WriteSnapshotDelta(snapshot, baseline, packet);
+        packet.WriteHeader();
+
+        Packet received;
+        received.Reset(ToRvalue(packet.buffer));
+        const auto *client_baseline = baseline != nullptr ? client_history.Get(baseline->id) : nullptr;
+        auto &decoded = client_history.Insert(snapshot.id, snapshot.tick);
+
+        if (!ReadSnapshotDelta(client_baseline, received, decoded) || !received.IsValidAndFinished()) {
+            return false;
+        }
+
+        ApplySnapshot(decoded, client.entities);
+        return IsSameSnapshot(decoded, snapshot);
+    };
+
+    server_history.Push(1).Capture(server.entities);
+    auto ok = send(nullptr);
+    auto s1 = server_history.latest_id;
+
+    server.entities.Get<CTank>(tank).flags = CTank::ROTATE_TURRET_LEFT;
+    server.entities.Get<CTank>(tank).weapon_type = Weapon::Type::SHOTGUN;
+    server.entities.Get<CPlanetPosition>(tank).delta = 1.0f;
+    server_history.Push(2).Capture(server.entities);
+    ok &= send(server_history.Get(s1));
+
+    server.entities.Get<CTank>(tank).flags = 0;
+    server.entities.Get<CTank>(tank).weapon_type = Weapon::Type::MORTAR;
+    server.entities.Get<CPlanetPosition>(tank).delta = 0.0f;
+    server.entities.Destroy(projectile);
+    server_history.Push(3).Capture(server.entities);
+    ok &= send(server_history.Get(s1));
+
+    const auto &client_tank = client.entities.Get<CTank>(tank);
+    return
+        ok &&
+        client_tank.flags == 0 &&
+        client_tank.weapon_type == Weapon::Type::MORTAR &&
+        client.entities.Get<CPlanetPosition>(tank).delta == 0.0f &&
+        client_history.GetLatest().entities.size() == 1;
+}
+
+// Size of the entity snapshots the server sends: everything against the deltas a client gets once it acknowledged the
+// snapshot from a round trip earlier, and against the same state when nothing changed
+static String RunReplicationReport(const BenchConfig &config) {
+    constexpr u32 ack_delay = 2; // In snapshots
+
+    std::mt19937 rng{config.seed};
+    BenchGameState state;
+    CreateScene(state, config, rng);
+
+    auto dt = static_cast<f32>(config.settings.tick_interval);
+    ReplicationHistory history;
+    Array<f64> capture_samples;
+    Array<f64> encode_samples;
+    Array<f64> full_bytes; // Per snapshot like the deltas, the projectiles come and go
+    Array<f64> delta_bytes;
+
+    for (size_t i = 0; i < config.num_ticks; ++i) {
+        state.Tick(dt);
+
+        if (state.tick % ReplicationHistory::SNAPSHOT_INTERVAL != 0) {
+            continue;
+        }
+
+        auto start = chrono::steady_clock::now();
+        auto &snapshot = history.Push(state.tick);
+        snapshot.Capture(state.entities);
+        capture_samples.emplace_back(chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count());
+
+        Packet full;
+        WriteSnapshotDelta(snapshot, nullptr, full);
+        full_bytes.emplace_back(static_cast<f64>(full.buffer.size()));
+
+        if (auto baseline = history.Get(snapshot.id - std::min(snapshot.id, ack_delay))) {
+            start = chrono::steady_clock::now();
+            Packet delta;
+            WriteSnapshotDelta(snapshot, baseline, delta);
+            encode_samples.emplace_back(chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count());
+            delta_bytes.emplace_back(static_cast<f64>(delta.buffer.size()));
+        }
+    }
+
+    // The same state twice, nothing but the counts are left. The last ticks may not have been captured above.
+    history.Push(state.tick).Capture(state.entities);
+    const auto &latest = history.GetLatest();
+    history.Push(state.tick).Capture(state.entities);
+    Packet idle;
+    WriteSnapshotDelta(history.GetLatest(), &latest, idle);
+
+    return R"({{
+  "replication_report": {{"entities": {}, "snapshots": {}, "full_bytes": {}, "delta_bytes": {}, "idle_delta_bytes": {}, "capture_us": {}, "encode_us": {}}}
+}})"_format(
+        history.GetLatest().entities.size(),
+        history.latest_id,
+        ToJson(ComputePercentiles(full_bytes)),
+        ToJson(ComputePercentiles(delta_bytes)),
+        idle.buffer.size(),
+        ToJson(ComputePercentiles(capture_samples)),
+        ToJson(ComputePercentiles(encode_samples)));
+}
+
+#ifdef LINUX
+// Server side cost of one poll per tick with many idle and some chatty connections, over socket pairs so that no
+// network is involved. Every tick each active peer sends a small message, the server waits and drains what was reported.
+static String RunPollerReport() {
+    constexpr size_t num_idle = 10'000;
+    constexpr size_t num_active = 1'000;
+    constexpr size_t num_ticks = 1000;
+
+    // Two descriptors per connection
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    auto max_connections = std::min<size_t>(num_idle + num_active, (limit.rlim_cur - 64) / 2);
+    if (max_connections < num_idle + num_active) {
+        LogWarning("simbench", "Descriptor limit {} only allows {} connections"_format(limit.rlim_cur, max_connections));
+    }
+
+    struct SocketPair {
+        int server;
+        int peer;
+    };
+
+    Array<SocketPair> pairs;
+
+    for (size_t i = 0; i < max_connections; ++i) {
+        int sds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sds) == -1) {
+            LogWarning("simbench", "Cannot create socket pair {}: {}"_format(i, net::GetErrorString()));
+            break;
+        }
+
+        pairs.emplace_back(SocketPair{sds[0], sds[1]});
+    }
+
+    auto num_active_pairs = std::min(num_active, pairs.size());
+    Array<net::Poller::Event> events;
+    char message[32] = {};
+    char buffer[4096];
+    String res;
+
+    for (auto backend : {net::PollerBackend::POLL, net::PollerBackend::EPOLL}) {
+        net::Poller poller;
+        if (!poller.Start(backend)) {
+            continue;
+        }
+
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            poller.Add(pairs[i].server, static_cast<i32>(i));
+        }
+
+        // epoll reports every new socket as writable once
+        events.clear();
+        poller.Wait(events, 0);
+
+        f64 total_us = 0.0;
+        f64 max_us = 0.0;
+        size_t num_events = 0;
+
+        for (size_t tick = 0; tick < num_ticks; ++tick) {
+            for (size_t i = 0; i < num_active_pairs; ++i) {
+                ::send(pairs[i].peer, message, sizeof(message), 0);
+            }
+
+            auto start = chrono::steady_clock::now();
+
+            events.clear();
+            poller.Wait(events, 0);
+
+            for (const auto &event : events) {
+                if (event.incoming) {
+                    while (::recv(pairs[event.id].server, buffer, sizeof(buffer), 0) > 0) {
+                    }
+                }
+            }
+
+            auto us = chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count();
+            total_us += us;
+            max_us = std::max(max_us, us);
+            num_events += events.size();
+        }
+
+        res += R"({}    {{"backend": "{}", "connections": {}, "active": {}, "events_per_tick": {:.1f}, "tick_us": {:.3f}, "max_us": {:.3f}}})"_format(
+            res.empty() ? "" : ",\n", net::ToString(backend), pairs.size(), num_active_pairs,
+            static_cast<f64>(num_events) / num_ticks, total_us / num_ticks, max_us);
+    }
+
+    // Completions instead of readiness, the data arrives with the single io_uring_enter of a tick. The peers live in
+    // this process, so the kernel may already do the receive work during their sends, outside of the measurement.
+    net::Uring uring;
+    if (uring.Start()) {
+        Array<net::Uring::Completion> completions;
+
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            uring.RecvMultishot(pairs[i].server, i);
+        }
+
+        uring.Submit(completions);
+
+        f64 total_us = 0.0;
+        f64 max_us = 0.0;
+        size_t num_completions = 0;
+
+        for (size_t tick = 0; tick < num_ticks; ++tick) {
+            for (size_t i = 0; i < num_active_pairs; ++i) {
+                ::send(pairs[i].peer, message, sizeof(message), 0);
+            }
+
+            auto start = chrono::steady_clock::now();
+
+            completions.clear();
+            uring.Submit(completions);
+
+            for (const auto &completion : completions) {
+                if (completion.data != nullptr) {
+                    uring.ReleaseBuffer(completion.buffer_id);
+                }
+
+                if (!completion.more && completion.user_data < pairs.size()) {
+                    uring.RecvMultishot(pairs[completion.user_data].server, completion.user_data);
+                }
+            }
+
+            auto us = chrono::duration<f64, std::micro>(chrono::steady_clock::now() - start).count();
+            total_us += us;
+            max_us = std::max(max_us, us);
+            num_completions += completions.size();
+        }
+
+        res += R"({}    {{"backend": "{}", "connections": {}, "active": {}, "events_per_tick": {:.1f}, "tick_us": {:.3f}, "max_us": {:.3f}}})"_format(
+            res.empty() ? "" : ",\n", net::ToString(net::PollerBackend::IO_URING), pairs.size(), num_active_pairs,
+            static_cast<f64>(num_completions) / num_ticks, total_us / num_ticks, max_us);
+    }
+
+    for (const auto &pair : pairs) {
+        close(pair.server);
+        close(pair.peer);
+    }
+
+    uring.Stop();
+
+    return R"({{
+  "poller_report": [
+{}
+  ]
+}})"_format(res);
+}
+#endif
+
+static Optional<GravitySolver> ParseGravitySolver(StringView name) {
+    for (u8 i = 0; i < static_cast<u8>(GravitySolver::COUNT); ++i) {
+        if (ToString(static_cast<GravitySolver>(i)) == name) {
+            return static_cast<GravitySolver>(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
+static Optional<Integrator> ParseIntegrator(StringView name) {
+    for (u8 i = 0; i < static_cast<u8>(Integrator::COUNT); ++i) {
+        if (ToString(static_cast<Integrator>(i)) == name) {
+            return static_cast<Integrator>(i);
+        }
+    }
+
+    return std::nullopt;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    Optional<String> output_path;
+    auto gravity_report = false;
+    auto trajectory_report = false;
+    auto predictor_report = false;
+    auto snapshot_report = false;
+    auto replication_report = false;
+    auto poller_report = false;
+
+    for (int i = 1; i < argc; ++i) {
+        StringView arg{argv[i]};
+        auto has_value = i + 1 < argc;
+
+        if (arg == "--planets" && has_value) {
+            config.num_planets = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--tanks" && has_value) {
+            config.num_tanks = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--projectiles" && has_value) {
+            config.num_projectiles = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--ticks" && has_value) {
+            config.num_ticks = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--warmup" && has_value) {
+            config.num_warmup_ticks = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && has_value) {
+            config.num_threads = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--seed" && has_value) {
+            config.seed = static_cast<u32>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--gravity" && has_value) {
+            auto solver = ParseGravitySolver(argv[++i]);
+            if (!solver.has_value()) {
+                LogError("simbench", "Unknown gravity solver {}"_format(argv[i]));
+                return EXIT_FAILURE;
+            }
+
+            config.settings.gravity_solver = solver.value();
+        } else if (arg == "--integrator" && has_value) {
+            auto integrator = ParseIntegrator(argv[++i]);
+            if (!integrator.has_value()) {
+                LogError("simbench", "Unknown integrator {}"_format(argv[i]));
+                return EXIT_FAILURE;
+            }
+
+            config.settings.integrator = integrator.value();
+        } else if (arg == "--substeps" && has_value) {
+            config.settings.max_substeps = std::clamp<u32>(std::strtoul(argv[++i], nullptr, 10), 1, SimSettings::MAX_SUBSTEPS);
+        } else if (arg == "--tick-interval" && has_value) {
+            config.settings.tick_interval = std::clamp<u32>(std::strtoul(argv[++i], nullptr, 10), 1, SimSettings::MAX_TICK_INTERVAL);
+        } else if (arg == "--simd") {
+            config.settings.simd_kernel = true;
+        } else if (arg == "--relaxed") {
+            config.settings.strict_kernel = false;
+        } else if (arg == "--deterministic") {
+            config.settings.deterministic = true;
+        } else if (arg == "--fire") {
+            config.fire = true;
+        } else if (arg == "--hitscan") {
+            config.settings.hitscan_machinegun = true;
+        } else if (arg == "--gravity-report") {
+            gravity_report = true;
+        } else if (arg == "--trajectory-report") {
+            trajectory_report = true;
+        } else if (arg == "--predictor-report") {
+            predictor_report = true;
+        } else if (arg == "--snapshot-report") {
+            snapshot_report = true;
+        } else if (arg == "--replication-report") {
+            replication_report = true;
+#ifdef LINUX
+        } else if (arg == "--poller-report") {
+            poller_report = true;
+#endif
+        } else if (arg == "--output" && has_value) {
+            output_path = argv[++i];
+        } else {
+            LogError("simbench", "Unknown argument: {}"_format(arg));
+            return EXIT_FAILURE;
+        }
+    }
+
+    WorkerPool worker_pool;
+    if (config.num_threads > 1) {
+        worker_pool.Start(config.num_threads - 1);
+    }
+
+    String json;
+
+    if (gravity_report) {
+        json = RunGravityReport(config);
+    } else if (trajectory_report) {
+        json = RunTrajectoryReport(config);
+    } else if (predictor_report) {
+        json = RunPredictorReport(config);
+    } else if (snapshot_report) {
+        if (!CheckSnapshotRestore(config)) {
+            LogError("simbench", "A fork restored from a snapshot diverged from the original");
+            return EXIT_FAILURE;
+        }
+
+        json = RunSnapshotReport(config);
+    } else if (replication_report) {
+        if (!CheckReplication()) {
+            LogError("simbench", "Rebuilt entity snapshots differ from the server's");
+            return EXIT_FAILURE;
+        }
+
+        json = RunReplicationReport(config);
+#ifdef LINUX
+    } else if (poller_report) {
+        json = RunPollerReport();
+#endif
+    } else {
+        json = RunBenchmark(config, worker_pool);
+    }
+
+    // The log goes to stdout as well, use --output for clean JSON
+    if (output_path.has_value()) {
+        auto file = std::fopen(output_path.value().c_str(), "w");
+        if (file == nullptr) {
+            LogError("simbench", "Cannot open {}"_format(output_path.value()));
+            return EXIT_FAILURE;
+        }
+
+        fmt::print(file, "{}\n", json);
+        std::fclose(file);
+    } else {
+        fmt::print("{}\n", json);
+    }
+
+    return EXIT_SUCCESS;
+}